@@ -0,0 +1,145 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/TriMesh.h>
+#include <cinder/gl/Vbo.h>
+#include <cinder/gl/Texture.h>
+#include <cinder/Sphere.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace viz {
+
+  /**
+  * @class AssetCache
+  * @brief A process wide cache of the meshes and textures loaded for the models, keyed by file path.
+  * Trackables which use the same model files (e.g. PSM1 and PSM2) share one copy of each mesh and texture, in memory and on the GPU. Assets which
+  * aren't cached yet are decoded in parallel on the shared thread pool and only uploaded to OpenGL on the calling thread, which must have the context.
+  * It should only be used from that thread. Each mesh also gets a few decimated levels of detail, which are cached on disk next to it like the mesh.
+  * Textures are loaded from a cache holding their whole mip chain (see TextureCache) so the images aren't decoded again and the mipmaps aren't
+  * generated on the GPU.
+  */
+  class AssetCache : boost::noncopyable {
+
+  public:
+
+    /**
+    * The files for one component of a model.
+    */
+    struct Request {
+      std::string obj_file; /**< The OBJ file with the mesh. */
+      std::string mtl_file; /**< The material file for the mesh. */
+      std::string texture_file; /**< The image file for the texture. */
+    };
+
+    /**
+    * A mesh and its vertex buffer.
+    */
+    struct Mesh {
+      Mesh() : error(0) {}
+      ci::TriMesh mesh; /**< The mesh in CPU memory. */
+      ci::gl::VboMesh vbo; /**< The mesh uploaded to OpenGL. */
+      float error; /**< For a level of detail, an upper bound on how far its surface is from the full mesh. 0 for the full mesh. */
+      ci::Sphere bounds; /**< A sphere around the mesh, in the mesh's coordinates. */
+      std::vector< boost::shared_ptr<Mesh> > levels_of_detail; /**< Decimated copies of the full mesh, each with about a quarter of the triangles of the one before. */
+    };
+
+    /**
+    * Get the cache shared by the whole process.
+    * @return The cache.
+    */
+    static AssetCache &Shared();
+
+    /**
+    * Make sure the assets for a set of model components are loaded. Any which aren't cached are decoded in parallel and then uploaded.
+    * @param[in] requests The components to load.
+    */
+    void Load(const std::vector<Request> &requests);
+
+    /**
+    * Get a loaded mesh.
+    * @param[in] request The component whose mesh to get.
+    * @return The mesh, which is shared with everything else using it.
+    */
+    boost::shared_ptr<const Mesh> GetMesh(const Request &request) const;
+
+    /**
+    * Get a loaded texture.
+    * @param[in] request The component whose texture to get.
+    * @return The texture, which refers to the same OpenGL texture as every other copy.
+    */
+    ci::gl::Texture GetTexture(const Request &request) const;
+
+    /**
+    * Look up a vertex buffer built from other assets, such as the packed parts of an instrument.
+    * @param[in] key Identifies the buffer, e.g. the path of the file describing the model.
+    * @return The buffer or an empty buffer if there isn't one.
+    */
+    ci::gl::VboMesh GetDerivedMesh(const std::string &key) const;
+
+    /**
+    * Store a vertex buffer built from other assets so it can be shared.
+    * @param[in] key Identifies the buffer.
+    * @param[in] vbo The buffer.
+    */
+    void AddDerivedMesh(const std::string &key, const ci::gl::VboMesh &vbo) { derived_meshes_[key] = vbo; }
+
+    /**
+    * Choose whether textures loaded from now on are DXT1 block compressed. They are only compressed if the driver supports S3TC and the image has no
+    * alpha channel.
+    * @param[in] compress Compress the textures.
+    */
+    static void SetCompressTextures(const bool compress) { compress_textures_ = compress; }
+
+    /**
+    * Choose whether assets loaded from now on skip everything that needs OpenGL, for processes which only use the meshes on the CPU. Meshes are
+    * loaded without vertex buffers and textures aren't loaded at all, GetTexture() returns an empty texture.
+    * @param[in] headless Skip the OpenGL parts.
+    */
+    static void SetHeadless(const bool headless) { headless_ = headless; }
+
+  protected:
+
+    AssetCache() {}
+
+    /**
+    * Get the key for a file, which is its canonical path if it exists so different relative paths to the same file are shared.
+    * @param[in] path The file path.
+    * @return The key.
+    */
+    static std::string FileKey(const std::string &path);
+
+    static std::string MeshKey(const Request &request) { return FileKey(request.obj_file) + "|" + FileKey(request.mtl_file); }
+
+    std::map<std::string, boost::shared_ptr<Mesh> > meshes_; /**< The loaded meshes, keyed by MeshKey(). */
+    std::map<std::string, ci::gl::Texture> textures_; /**< The loaded textures, keyed by FileKey() of the image. */
+    std::map<std::string, ci::gl::VboMesh> derived_meshes_; /**< Vertex buffers built from the loaded meshes. */
+
+    static bool compress_textures_; /**< Whether to block compress the textures. */
+    static bool headless_; /**< Whether to skip the OpenGL uploads. */
+
+  };
+
+}
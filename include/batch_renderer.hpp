@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <functional>
+
+#include "session.hpp"
+#include "frame_writer.hpp"
+#include "pixel_readback.hpp"
+#include "bounded_queue.hpp"
+
+namespace viz {
+
+  /**
+  * @class BatchRenderer
+  * @brief Renders a whole session offscreen without a window.
+  * Loads the same config file as the interactive app, then loads every frame in turn, draws the eye, 3D and trajectory views into framebuffers and
+  * saves them (as AVI files or PNG sequences, following save-format) along with the poses to the session's output directory. Frames are processed as fast as they can be rendered.
+  * The work is pipelined: one thread decodes and undistorts the video, a second loads the poses and runs the kinematics, the calling thread renders and
+  * reads back the views and the shared ThreadPool compresses them if they're saved as PNG. Each stage works on a later frame than the next one, with a small bounded queue
+  * in between, and the frames go through every stage in order so the output is the same as processing them one at a time.
+  */
+  class BatchRenderer : public Session {
+
+  public:
+
+    /**
+    * Load the shader. Needs a current OpenGL context.
+    * @param[in] resource_dir The directory containing the shader sources.
+    */
+    explicit BatchRenderer(const std::string &resource_dir);
+
+    /**
+    * Load a session from a config file and render all of its frames.
+    * @param[in] config_path The path to the app config file.
+    * @return The number of frames rendered.
+    */
+    size_t Run(const std::string &config_path);
+
+  protected:
+
+    /**
+    * @struct PipelineFrame
+    * @brief A frame passed between the pipeline stages.
+    */
+    struct PipelineFrame {
+      cv::Mat left; /**< The left frame, ready to upload. */
+      cv::Mat right; /**< The right frame, ready to upload. */
+      FramePoses poses; /**< The poses for this frame, filled in by the pose stage. The trajectories only hold the entries added since the previous frame. */
+    };
+
+    /**
+    * Read and prepare video frames until the video runs out or the output queue is closed. Runs on its own thread.
+    * @param[out] output Where to send the frames.
+    */
+    void decodeFrames(BoundedQueue<PipelineFrame> &output);
+
+    /**
+    * Load the poses for each decoded frame, save them and attach a copy to the frame. Only the new trajectory entries are attached, as copying the
+    * whole trajectories into every frame would make a run quadratic in its length. Runs on its own thread and stops when a pose file or the
+    * video runs out.
+    * @param[in] input The decoded frames.
+    * @param[out] output Where to send the frames with their poses.
+    */
+    void loadFramePoses(BoundedQueue<PipelineFrame> &input, BoundedQueue<PipelineFrame> &output);
+
+    /**
+    * Make a frame's poses the ones the views are drawn with, appending its new trajectory entries to the trajectories received so far.
+    * @param[in,out] poses The frame's poses, which are swapped out.
+    */
+    void receivePoses(FramePoses &poses);
+
+    /**
+    * Draw a view into a framebuffer and start reading it back. Whichever earlier frame of the view finishes reading back is queued for saving.
+    * @param[in] framebuffer The framebuffer to draw into.
+    * @param[in] readback The readback for this view.
+    * @param[in] writer Where to save the view.
+    * @param[in] draw_view The drawing function.
+    */
+    void renderView(ci::gl::Fbo &framebuffer, PixelReadback &readback, FrameWriter &writer, const std::function<void()> &draw_view);
+
+    /**
+    * Save the frames of a view which are still being read back.
+    * @param[in] readback The readback for this view.
+    * @param[in] writer Where to save the view.
+    */
+    void finishView(PixelReadback &readback, FrameWriter &writer);
+
+    cv::Mat readback_frame_; /**< Storage for frames as they finish reading back. */
+
+  };
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+namespace viz {
+
+  /**
+  * @class BoundedQueue
+  * @brief A first in, first out queue for passing items between threads with a fixed maximum size.
+  * Push() waits while the queue is full so a fast producer can't run arbitrarily far ahead of its consumer. Closing the queue wakes up both sides,
+  * which lets either end of a pipeline stage stop the other.
+  */
+  template<typename T>
+  class BoundedQueue {
+
+  public:
+
+    /**
+    * Create an empty queue.
+    * @param[in] capacity The maximum number of items waiting in the queue.
+    */
+    explicit BoundedQueue(const std::size_t capacity) : capacity_(capacity > 0 ? capacity : 1), closed_(false) {}
+
+    /**
+    * Add an item to the back of the queue, waiting for space if it's full.
+    * @param[in] item The item to add.
+    * @return False if the queue was closed, in which case the item is dropped.
+    */
+    bool Push(T item){
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this](){ return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+      }
+      not_empty_.notify_one();
+
+      return true;
+
+    }
+
+    /**
+    * Take the item from the front of the queue, waiting for one if it's empty. Items pushed before the queue was closed can still be taken.
+    * @param[out] item The item.
+    * @return False if the queue is closed and empty.
+    */
+    bool Pop(T &item){
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this](){ return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+      }
+      not_full_.notify_one();
+
+      return true;
+
+    }
+
+    /**
+    * Close the queue. Any further Push() fails and Pop() fails once the queue is empty.
+    */
+    void Close(){
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closed_ = true;
+      }
+      not_full_.notify_all();
+      not_empty_.notify_all();
+
+    }
+
+  protected:
+
+    std::size_t capacity_; /**< The maximum number of items in the queue. */
+    bool closed_; /**< Set when no more items will be accepted. */
+    std::deque<T> items_; /**< The items, oldest first. */
+    std::mutex mutex_; /**< Protects the items and the closed flag. */
+    std::condition_variable not_full_; /**< Signalled when an item is taken or the queue is closed. */
+    std::condition_variable not_empty_; /**< Signalled when an item is added or the queue is closed. */
+
+  };
+
+}
@@ -89,11 +89,71 @@ namespace viz {
     */
     void TurnOffLight();
 
+    /**
+    * Build the maps to remove the lens distortion from this camera's images. The maps are fixed point (CV_16SC2) and are cached in a file so they
+    * only need to be computed once for each calibration. The undistorted image keeps the same camera matrix so it lines up with the rendered overlays.
+    * @param[in] cache_file The file to load the maps from, or to save them to if it doesn't exist or is for a different calibration.
+    */
+    void SetupUndistortion(const std::string &cache_file);
+
+    /**
+    * Check if the undistortion maps have been set up.
+    * @return True if Undistort() will remove the lens distortion.
+    */
+    bool CanUndistort() const { return !undistort_map_xy_.empty(); }
+
+    /**
+    * Remove the lens distortion from an image using the cached maps. The remap is split into stripes of rows which are run in parallel.
+    * @param[in] image The distorted image from this camera.
+    * @param[in,out] undistorted_buffer Storage for the undistorted image, reused between calls to avoid reallocation.
+    * @return The undistorted image, or image itself if the maps aren't set up or the image is not the calibrated size.
+    */
+    const cv::Mat &Undistort(const cv::Mat &image, cv::Mat &undistorted_buffer) const;
+
+    /**
+    * Build the map which distorts images drawn with the pinhole projection so they line up with the raw camera images. For each pixel of the raw
+    * image it holds the texture coordinates of the same point in the pinhole image, with the rows and t counted from the bottom as in OpenGL. The
+    * map is cached in a file like the undistortion maps.
+    * @param[in] cache_file The file to load the map from, or to save it to if it doesn't exist or is for a different calibration.
+    */
+    void SetupDistortionMap(const std::string &cache_file);
+
+    /**
+    * Get the map built by SetupDistortionMap().
+    * @return The map (CV_32FC2), empty if it hasn't been set up.
+    */
+    const cv::Mat &GetDistortionMap() const { return distortion_map_; }
+
+    /**
+    * Project a point into the image on the CPU. Uses the same pinhole model as the OpenGL projection, so without distortion the point lands where it
+    * is drawn in the eye view.
+    * @param[in] point The point in this camera's coordinate system (x right, y down, z along the optical axis).
+    * @param[in] apply_distortion Apply the lens distortion to get the position in the raw, rather than undistorted, camera image.
+    * @return The position in pixels from the top left of the image, or (-1, -1) if the point is behind the camera.
+    */
+    ci::Vec2f ProjectPoint(const ci::Vec3f &point, const bool apply_distortion) const;
+
+    /**
+    * Project a set of points from a model's coordinate system into the image on the CPU.
+    * @param[in] points The points in model coordinates.
+    * @param[in] model_to_camera The transform from model coordinates to this camera's coordinates, i.e. the inverse camera pose times the model pose.
+    * @param[in] apply_distortion Apply the lens distortion to get positions in the raw camera image.
+    * @param[out] projected The position of each point, see ProjectPoint().
+    */
+    void ProjectPoints(const std::vector<ci::Vec3f> &points, const ci::Matrix44f &model_to_camera, const bool apply_distortion, std::vector<ci::Vec2f> &projected) const;
+
   protected:
 
+    /**
+    * Get the camera matrix in OpenCV coordinates (principal point measured from the top of the image) rather than the GL coordinates stored in camera_matrix_.
+    * @return The OpenCV camera matrix.
+    */
+    cv::Mat GetOpenCVCameraMatrix() const;
+
     cv::Mat camera_matrix_; /**< The camera calibration matrix. */
     ci::Matrix44f gl_projection_matrix_; /**< The GL_PROJECTIONMATRIX for this camera calibration. Ignores distortion. */
     cv::Mat distortion_params_; /**< The camera distortion parameters. */
+    double distortion_coefficients_[8]; /**< The distortion parameters as k1, k2, p1, p2, k3, k4, k5, k6 with any missing ones set to 0, for ProjectPoint(). */
 
     int image_width_; /**< The x resolution of the camera image. */
     int image_height_; /**< The y resolution of the camera image. */
@@ -101,6 +161,10 @@ namespace viz {
     int far_clip_distance_; /**< The far clip plane for OpenGL.  */
 
     bool is_setup_; /**< Flag for whether the camera calibration is loaded. */
+
+    cv::Mat undistort_map_xy_; /**< The integer part of the undistortion map (CV_16SC2). */
+    cv::Mat undistort_map_interp_; /**< The interpolation table indices of the undistortion map (CV_16UC1). */
+    cv::Mat distortion_map_; /**< The texture coordinates in the pinhole image of each raw image pixel (CV_32FC2), see SetupDistortionMap(). */
      
     ci::gl::Light light_; /**< A cinder wrapper for an OpenGL light. */
 
@@ -129,6 +193,16 @@ namespace viz {
     */
     void Setup(const std::string &calibration_file, const int near_clip_distance, const int far_clip_distance); 
 
+    /**
+    * Set up undistortion for both eyes. The maps are cached next to the calibration file.
+    */
+    void SetupUndistortion();
+
+    /**
+    * Set up the maps to distort the overlays for both eyes. The maps are cached next to the calibration file.
+    */
+    void SetupDistortionMaps();
+
     /**
     * Move the GL_MODELVIEW to the left camera position and setup the GL_VIEWPORT.
     * @param[in] cam A Cinder GL 'MayaCam' which is used to wrap up the data about this camera.
@@ -176,6 +250,13 @@ namespace viz {
     */
     ci::Matrix33f getExtrinsicRotation() const { return extrinsic_rotation_; }
 
+    /**
+    * Get the transform from left eye coordinates to right eye coordinates (both x right, y down, z along the optical axis), matching the view
+    * setupRightCamera() sets up.
+    * @return The transform.
+    */
+    ci::Matrix44f getLeftToRightTransform() const;
+
     /**
     * Switch on the left eye's light.
     */
@@ -228,6 +309,8 @@ namespace viz {
     Camera left_eye_; /**< The camera corresponding to the stereo rig's left eye. */
     Camera right_eye_; /**< The camera corresponding to the stereo rig's right eye. */
 
+    std::string calibration_filename_; /**< The calibration file the cameras were loaded from. */
+
     GLint viewport_cache_[4]; /**< Cache of the viewport (when we change it for the eyes so it's not lost). */
 
     ci::Matrix33f extrinsic_rotation_; /**< Rotation between the eye's coordinates system. If it's in Bouguet format this is rotation matrix which transforms points in left eye coordinate to right eye coordiantes. If GL then it's transformation that transforms coordinates system from left to right (i.e. the inverse of the Bouguet one). */
@@ -0,0 +1,137 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Vbo.h>
+#include <cinder/gl/GlslProg.h>
+#include <cinder/Matrix.h>
+#include <boost/noncopyable.hpp>
+#include <vector>
+#include <map>
+
+namespace viz {
+
+  /**
+  * @class CoreRenderer
+  * @brief Draws the models with uniform buffers and vertex arrays instead of the fixed function state.
+  * The camera and light for a frame are written to one uniform buffer when the frame begins, and each draw writes its model matrices to the next
+  * slot of a second buffer, so a draw is just a buffer write, a range bind, a vertex array bind and the draw call. The shader doesn't read any of the
+  * fixed function matrices or lights. Cinder creates a compatibility context, so the uniform buffers and vertex arrays come from the ARB extensions
+  * and the vertex arrays record the VboMesh's own client arrays.
+  */
+  class CoreRenderer : boost::noncopyable {
+
+  public:
+
+    CoreRenderer() : draw_stride_(0), next_draw_(0), previous_program_(0) {}
+
+    /**
+    * Delete the vertex arrays.
+    */
+    ~CoreRenderer() { Release(); }
+
+    /**
+    * Check if the driver supports uniform buffers and vertex arrays, which the renderer needs.
+    * @return True if the renderer can be used.
+    */
+    static bool IsSupported();
+
+    /**
+    * Compile the shader and create the uniform buffers, dropping anything from an earlier setup. Needs a current OpenGL context.
+    */
+    void Setup();
+
+    /**
+    * Drop the shader and the vertex arrays, IsSetup() is false until Setup() is called again.
+    */
+    void Release();
+
+    /**
+    * Check if Setup() has succeeded.
+    * @return True if the renderer can draw.
+    */
+    bool IsSetup() const { return shader_; }
+
+    /**
+    * Write the frame's camera and light to the frame uniform buffer and bind the shader. Models drawn until EndFrame() use the renderer.
+    * @param[in] projection The projection matrix.
+    * @param[in] view The transform from world coordinates to OpenGL eye coordinates.
+    * @param[in] light_position The light position in eye coordinates.
+    */
+    void BeginFrame(const ci::Matrix44f &projection, const ci::Matrix44f &view, const ci::Vec3f &light_position);
+
+    /**
+    * Stop drawing with the renderer and restore the shader that was bound before BeginFrame().
+    */
+    void EndFrame();
+
+    /**
+    * Draw a mesh with the texture bound to unit 0.
+    * @param[in] vbo The mesh.
+    * @param[in] model The transform from model coordinates to world coordinates.
+    */
+    void Draw(const ci::gl::VboMesh &vbo, const ci::Matrix44f &model);
+
+    /**
+    * Draw a mesh made of up to four parts which each have their own transform and texture, with the part each vertex belongs to in its color as
+    * in the packed instrument meshes. Part n's texture should be bound to unit n.
+    * @param[in] vbo The mesh.
+    * @param[in] models The transform from model coordinates to world coordinates for each part.
+    */
+    void DrawParts(const ci::gl::VboMesh &vbo, const std::vector<ci::Matrix44f> &models);
+
+    /**
+    * Get the renderer which is drawing a frame, if there is one.
+    * @return The renderer between BeginFrame() and EndFrame(), otherwise null.
+    */
+    static CoreRenderer *Current() { return current_; }
+
+  protected:
+
+    /**
+    * Write the model matrices to the next slot of the draw uniform buffer and draw the mesh.
+    * @param[in] vbo The mesh.
+    * @param[in] models The transforms for each part.
+    * @param[in] num_models The number of parts, 1 for a mesh which isn't packed.
+    */
+    void DrawInternal(const ci::gl::VboMesh &vbo, const ci::Matrix44f *models, const std::size_t num_models);
+
+    /**
+    * Get the vertex array for a mesh, recording it the first time the mesh is drawn.
+    * @param[in] vbo The mesh.
+    * @return The vertex array.
+    */
+    GLuint VertexArray(const ci::gl::VboMesh &vbo);
+
+    ci::gl::GlslProg shader_; /**< Phong shader which takes everything from the uniform buffers. */
+    ci::gl::Vbo frame_uniforms_; /**< The camera and light for the current frame. */
+    ci::gl::Vbo draw_uniforms_; /**< A ring of per draw slots holding the model matrices. */
+    std::size_t draw_stride_; /**< The size of a draw slot, rounded up to the uniform buffer offset alignment. */
+    std::size_t next_draw_; /**< The slot the next draw writes to. */
+    std::map<GLuint, GLuint> vertex_arrays_; /**< The vertex array for each mesh, keyed on the mesh's vertex buffer. */
+    GLint previous_program_; /**< The shader bound when BeginFrame() was called. */
+
+    static CoreRenderer *current_; /**< The renderer drawing a frame, if there is one. */
+
+  };
+
+}
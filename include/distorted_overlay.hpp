@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Fbo.h>
+#include <cinder/gl/Texture.h>
+
+#include "camera.hpp"
+
+namespace viz {
+
+  /**
+  * @class DistortedOverlay
+  * @brief Draws overlays with a camera's lens distortion so they line up with its raw images.
+  * OpenGL can only draw with the pinhole projection, so the overlay is drawn into its own framebuffer and then warped onto the raw image by looking
+  * up each pixel in the camera's distortion map (see Camera::SetupDistortionMap()). The warp and blending over the image are a single full screen
+  * pass, and the map is computed once per calibration so the per-frame cost is just one texture lookup per pixel.
+  */
+  class DistortedOverlay {
+
+  public:
+
+    /**
+    * Create the framebuffer and upload the distortion map. Needs a current OpenGL context.
+    * @param[in] camera The camera, which must have its distortion map set up.
+    */
+    void Setup(const Camera &camera);
+
+    /**
+    * Check if Setup() has been called.
+    * @return True if the overlay is drawn distorted.
+    */
+    bool IsSetup() const { return framebuffer_; }
+
+    /**
+    * Start drawing the overlay. Switches to the overlay's framebuffer and clears it to transparent, the previous framebuffer is remembered.
+    */
+    void Begin();
+
+    /**
+    * Stop drawing the overlay, switch back to the previous framebuffer and blend the distorted overlay over the camera image already drawn there.
+    */
+    void End();
+
+  protected:
+
+    ci::gl::Fbo framebuffer_; /**< The overlay drawn with the pinhole projection. */
+    ci::gl::Texture distortion_map_; /**< The camera's distortion map as a float texture. */
+    GLint previous_framebuffer_; /**< The framebuffer bound when Begin() was called. */
+
+  };
+
+}
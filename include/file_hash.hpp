@@ -0,0 +1,93 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace viz {
+
+  const boost::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull; /**< The starting value of an FNV-1a hash. */
+
+  /**
+  * Mix some bytes into a running FNV-1a hash.
+  * @param[in] data The bytes to add.
+  * @param[in] size The number of bytes.
+  * @param[in,out] hash The hash so far.
+  */
+  inline void HashBytes(const void *data, const std::size_t size, boost::uint64_t &hash){
+
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i){
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+
+  }
+
+  /**
+  * Add the size and contents of a file to a running FNV-1a hash. The file is memory mapped rather than read through a stream.
+  * @param[in] path The file to hash.
+  * @param[in,out] hash The hash so far.
+  */
+  inline void HashFile(const std::string &path, boost::uint64_t &hash){
+
+    const boost::uint64_t size = boost::filesystem::file_size(path);
+    HashBytes(&size, sizeof(size), hash);
+    if (size == 0) return;
+
+    boost::interprocess::file_mapping mapping(path.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+    HashBytes(region.get_address(), region.get_size(), hash);
+
+  }
+
+  /**
+  * Get the places a file derived from a source file can be cached, in the order they should be tried: next to the source file and then, in case
+  * that directory can't be written to, in a directory in the system temp directory under a name made from the hash of the source.
+  * @param[in] source_file The file the cache is built from.
+  * @param[in] extension The extension added to the source file name for the cache file, e.g. ".vizmesh".
+  * @param[in] temp_subdirectory The directory in the temp directory to use.
+  * @param[in] source_hash The hash of the source file (and anything else the cache depends on).
+  * @return The candidate cache paths.
+  */
+  inline std::vector<std::string> CachePaths(const std::string &source_file, const std::string &extension, const std::string &temp_subdirectory, const boost::uint64_t source_hash){
+
+    std::vector<std::string> paths;
+    paths.push_back(source_file + extension);
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << source_hash << extension;
+    boost::system::error_code ec;
+    const boost::filesystem::path temp_dir = boost::filesystem::temp_directory_path(ec);
+    if (!ec) paths.push_back((temp_dir / temp_subdirectory / ss.str()).string());
+
+    return paths;
+
+  }
+
+}
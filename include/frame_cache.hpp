@@ -0,0 +1,110 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <opencv2/core/core.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <string>
+
+namespace viz {
+
+  /**
+  * @class FrameCache
+  * @brief An on-disk cache of decoded video frames.
+  * Frames are stored uncompressed in fixed size, page aligned slots of a memory mapped file next to the video, so reading a cached frame is a copy
+  * out of the page cache rather than a decode. The file is limited to a size budget and the least recently used frame is evicted when it is full.
+  * The slot table (including the last use times) is stored in the file so the cache survives between runs. It is only safe to use from one process.
+  */
+  class FrameCache : boost::noncopyable {
+
+  public:
+
+    /**
+    * Open the cache for a video, creating it if it doesn't exist. An existing cache is cleared if the video has changed or the frame format or budget
+    * don't match.
+    * @param[in] video_path The path to the video whose frames are cached.
+    * @param[in] frame_size The size of the decoded frames.
+    * @param[in] type The OpenCV type of the decoded frames.
+    * @param[in] budget_bytes The maximum size of the cached frame data. At least one frame is always cached.
+    */
+    FrameCache(const std::string &video_path, const cv::Size &frame_size, const int type, const std::size_t budget_bytes);
+
+    /**
+    * Check if a frame is in the cache.
+    * @param[in] frame The frame index.
+    * @return True if it is.
+    */
+    bool Contains(const std::size_t frame) const { return index_.count(frame) > 0; }
+
+    /**
+    * Copy a frame out of the cache.
+    * @param[in] frame The frame index.
+    * @param[out] image The frame. Reallocated only if it isn't already the right size and type.
+    * @return True if the frame was cached, false otherwise.
+    */
+    bool Get(const std::size_t frame, cv::Mat &image);
+
+    /**
+    * Add a frame to the cache, evicting the least recently used frame if the cache is full. Frames of the wrong size or type are ignored.
+    * @param[in] frame The frame index.
+    * @param[in] image The decoded frame.
+    */
+    void Put(const std::size_t frame, const cv::Mat &image);
+
+  protected:
+
+    struct Header;
+    struct Slot;
+
+    /**
+    * Write a new header and mark every slot as empty.
+    * @param[in] source_size The size of the video file.
+    * @param[in] source_time The last write time of the video file.
+    */
+    void Reset(const boost::uint64_t source_size, const boost::int64_t source_time);
+
+    /**
+    * Get a pointer to the frame data in a slot.
+    * @param[in] slot The slot index.
+    * @return The start of the slot's frame data.
+    */
+    unsigned char *SlotData(const std::size_t slot) { return data_ + slot * slot_stride_; }
+
+    std::string cache_path_; /**< The path to the cache file. */
+    cv::Size frame_size_; /**< The size of the cached frames. */
+    int type_; /**< The OpenCV type of the cached frames. */
+    std::size_t frame_bytes_; /**< The number of bytes in a frame. */
+    std::size_t slot_stride_; /**< The number of bytes between slots, a whole number of pages. */
+    std::size_t num_slots_; /**< The number of frames the cache can hold. */
+
+    boost::interprocess::mapped_region region_; /**< The mapping of the whole cache file. */
+    Header *header_; /**< The file header, at the start of the mapping. */
+    Slot *slots_; /**< The slot table, after the header. */
+    unsigned char *data_; /**< The start of the first slot, after the slot table. */
+
+    std::map<std::size_t, std::size_t> index_; /**< Maps from the frame index to the slot holding it. */
+
+  };
+
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
+#include <future>
+#include <functional>
+#include <string>
+
+namespace viz {
+
+  /**
+  * @class FrameWriter
+  * @brief Somewhere to save the frames of a view, either a PNG sequence or AVI files. See OpenFrameWriter().
+  */
+  class FrameWriter : boost::noncopyable {
+
+  public:
+
+    virtual ~FrameWriter() {}
+
+    /**
+    * Write a frame, or queue it to be written.
+    * @param[in] frame The frame (8 bit BGR), the right way up. It is copied if it's needed after returning so the caller can reuse it.
+    */
+    virtual void Write(const cv::Mat &frame) = 0;
+
+  };
+
+  /**
+  * Open a writer for a view in the format picked by the save-format option.
+  * @param[in] save_format "png" for a numbered PNG sequence in its own directory named after the view, otherwise uncompressed AVI files.
+  * @param[in] directory The output directory.
+  * @param[in] name The name of the view, which starts each file name.
+  * @param[in] frame_size The size of the frames, for the AVI files.
+  * @param[in] png_compression The zlib compression level (0-9) for the PNG sequence.
+  * @return The writer.
+  */
+  boost::shared_ptr<FrameWriter> OpenFrameWriter(const std::string &save_format, const std::string &directory, const std::string &name, const cv::Size &frame_size, const int png_compression);
+
+  /**
+  * @class VideoFileWriter
+  * @brief Writes frames to uncompressed AVI files on the calling thread, starting a new file every 2000 frames so none of them get too large.
+  * The files are named prefix_0.avi, prefix_1.avi and so on.
+  */
+  class VideoFileWriter : public FrameWriter {
+
+  public:
+
+    /**
+    * Create a writer and open the first file, creating the output directory if needed.
+    * @param[in] directory The directory to write the files to.
+    * @param[in] prefix The start of each file name, the file number and extension are appended.
+    * @param[in] frame_size The size of the frames.
+    */
+    VideoFileWriter(const std::string &directory, const std::string &prefix, const cv::Size &frame_size);
+
+    /**
+    * Write a frame, moving on to the next file if this one is full.
+    * @param[in] frame The frame to write.
+    */
+    void Write(const cv::Mat &frame);
+
+  protected:
+
+    /**
+    * Close the current file and open the next one.
+    */
+    void OpenNextFile();
+
+    std::string directory_; /**< The output directory. */
+    std::string prefix_; /**< The start of each file name. */
+    cv::Size frame_size_; /**< The size of the frames. */
+    cv::VideoWriter writer_; /**< The open file. */
+    std::size_t file_count_; /**< The number of files opened so far. */
+    std::size_t frames_in_file_; /**< The number of frames written to the open file. */
+
+  };
+
+  /**
+  * @class FrameSequenceWriter
+  * @brief Writes frames as a numbered sequence of lossless PNG images.
+  * Compression and writing run on the shared ThreadPool so the render loop only pays for a copy of the frame. Jobs are retired in the order they
+  * were submitted and the number of frames in flight is bounded, so memory use stays fixed and any write error is reported for the right frame.
+  */
+  class FrameSequenceWriter : public FrameWriter {
+
+  public:
+
+    /**
+    * Create a writer, creating the output directory if needed.
+    * @param[in] directory The directory to write the images to.
+    * @param[in] prefix The start of each file name, the frame number and extension are appended.
+    * @param[in] png_compression The zlib compression level, 0 (fastest, largest) to 9 (slowest, smallest).
+    */
+    FrameSequenceWriter(const std::string &directory, const std::string &prefix, const int png_compression);
+
+    /**
+    * Wait for all of the frames to be written.
+    */
+    ~FrameSequenceWriter();
+
+    /**
+    * Queue a frame to be written. Blocks if too many frames are already waiting.
+    * @param[in] frame The frame to write. It is copied so the caller can reuse it.
+    */
+    void Write(const cv::Mat &frame);
+
+    /**
+    * Wait for all of the queued frames to be written.
+    */
+    void Flush();
+
+    /**
+    * Get the number of frames written or queued so far.
+    * @return The number of frames.
+    */
+    std::size_t FrameCount() const { return frame_count_; }
+
+  protected:
+
+    /**
+    * Get the path of the next frame in the sequence and move on to the one after.
+    * @param[in] extension The file extension, including the dot.
+    * @return The path.
+    */
+    std::string NextPath(const std::string &extension);
+
+    /**
+    * Queue a job which writes a frame on the shared ThreadPool. Blocks if too many frames are already waiting.
+    * @param[in] job The job, which should only use copies of the frame data.
+    */
+    void Queue(const std::function<void()> &job);
+
+    /**
+    * Wait for the oldest queued frame to be written. Throws if writing it failed.
+    */
+    void RetireOldest();
+
+    std::string directory_; /**< The output directory. */
+    std::string prefix_; /**< The start of each file name. */
+    int png_compression_; /**< The zlib compression level. */
+
+    std::size_t frame_count_; /**< The number of the next frame. */
+    std::size_t max_in_flight_; /**< The maximum number of frames queued at once. */
+    std::deque< std::future<void> > in_flight_; /**< The queued frames, oldest first. */
+
+  };
+
+  /**
+  * @class GroundTruthWriter
+  * @brief Writes the depth, normals and labels of each frame as a numbered sequence of binary files.
+  * Each .vizgt file is a header of the magic bytes "VZGT" followed by the version, width and height as 32 bit unsigned integers, then three planes
+  * of width x height values in row order from the top left: the depth along the optical axis as 32 bit floats, the unit normal in camera coordinates
+  * as three 16 bit signed integers (scaled by 32767) and the label as an 8 bit unsigned integer. Pixels which nothing was drawn on are all zero.
+  * All values are in the writing machine's byte order (little endian on x86). Files are written on the shared ThreadPool like FrameSequenceWriter.
+  */
+  class GroundTruthWriter : public FrameSequenceWriter {
+
+  public:
+
+    /**
+    * Create a writer, creating the output directory if needed.
+    * @param[in] directory The directory to write the files to.
+    * @param[in] prefix The start of each file name, the frame number and extension are appended.
+    */
+    GroundTruthWriter(const std::string &directory, const std::string &prefix) : FrameSequenceWriter(directory, prefix, 0) {}
+
+    /**
+    * Queue a frame to be written. Blocks if too many frames are already waiting.
+    * @param[in] depth The depth image (CV_32FC1).
+    * @param[in] normals The normal image (CV_32FC3).
+    * @param[in] labels The label image (CV_8UC1).
+    */
+    void Write(const cv::Mat &depth, const cv::Mat &normals, const cv::Mat &labels);
+
+  };
+
+}
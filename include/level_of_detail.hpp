@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/Sphere.h>
+#include <cinder/Matrix.h>
+
+namespace viz {
+
+  /**
+  * Work out how many pixels a unit in model coordinates covers at the front of a bounding sphere, from the current GL matrices and viewport.
+  * Used to pick which level of detail to draw.
+  * @param[in] bounds The bounding sphere in model coordinates.
+  * @param[in] transform The transform from world coordinates to model coordinates, on top of the current modelview.
+  * @return The number of pixels per unit, which is the largest float if the sphere is at or behind the eye.
+  */
+  float PixelsPerUnit(const ci::Sphere &bounds, const ci::Matrix44f &transform = ci::Matrix44f::identity());
+
+}
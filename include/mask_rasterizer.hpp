@@ -0,0 +1,129 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/TriMesh.h>
+#include <cinder/Matrix.h>
+#include <opencv2/core/core.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <vector>
+
+#include "camera.hpp"
+
+namespace viz {
+
+  /**
+  * @class MaskRasterizer
+  * @brief Draws label masks of the models on the CPU, for machines without a GPU, optionally with their depth and surface normals.
+  * Uses the same pinhole projection as the eye views (without distortion), see MaskRenderer for warping the masks onto the raw frames. The image is split into
+  * square tiles: the triangles of each model are transformed, clipped to the near plane, projected and binned into the tiles they touch in parallel,
+  * then the tiles are filled in parallel, each with its own part of the depth buffer so no locking is needed. Pixels are sampled at their centres with
+  * a top-left fill rule, so neighbouring triangles never both cover a pixel. Normals are interpolated from the mesh's vertex normals with perspective
+  * correction, or are the face normals if the mesh doesn't have any.
+  */
+  class MaskRasterizer {
+
+  public:
+
+    /**
+    * A mesh to draw and the label to fill its pixels with.
+    */
+    struct Instance {
+      boost::shared_ptr<const ci::TriMesh> mesh; /**< The mesh in model coordinates. */
+      ci::Matrix44f model_to_camera; /**< The transform from model coordinates to the camera's coordinates (x right, y down, z along the optical axis). */
+      boost::uint8_t label; /**< The value written to the pixels the mesh covers. */
+    };
+
+    /**
+    * Create a rasterizer for a camera.
+    * @param[in] camera The camera to project with. It must outlive the rasterizer.
+    * @param[in] near_clip Geometry closer than this to the camera is clipped away, as it is by the OpenGL near plane.
+    */
+    MaskRasterizer(const Camera &camera, const float near_clip);
+
+    /**
+    * Draw a label mask and, if asked for, the depth and normal of each pixel.
+    * @param[in] instances The meshes to draw. Where they overlap the nearest one wins, or the first one if they are at the same depth.
+    * @param[out] labels The mask (CV_8UC1) the size of the camera image, 0 where nothing was drawn.
+    * @param[out] depth If not null, the depth along the optical axis of each pixel (CV_32FC1), 0 where nothing was drawn.
+    * @param[out] normals If not null, the unit surface normal of each pixel in camera coordinates (CV_32FC3), 0 where nothing was drawn.
+    */
+    void Draw(const std::vector<Instance> &instances, cv::Mat &labels, cv::Mat *depth = 0, cv::Mat *normals = 0);
+
+  protected:
+
+    /**
+    * A triangle after projection, ready to fill.
+    */
+    struct ScreenTriangle {
+      float x[3]; /**< The x coordinates of the corners in pixels, ordered so the triangle has a positive area. */
+      float y[3]; /**< The y coordinates of the corners in pixels. */
+      float inverse_depth[3]; /**< One over the depth of each corner, which is linear in screen space. */
+      ci::Vec3f normal[3]; /**< The normal at each corner in camera coordinates divided by its depth, which is also linear in screen space. */
+      int min_x, min_y, max_x, max_y; /**< The pixels the triangle's bounding box covers, clamped to the image. */
+    };
+
+    /**
+    * A corner of a triangle in camera coordinates.
+    */
+    struct CameraVertex {
+      ci::Vec3f point; /**< The position. */
+      ci::Vec3f normal; /**< The normal. */
+    };
+
+    /**
+    * Transform, clip and project the triangles of an instance and bin them into the tiles they touch.
+    * @param[in] instance The instance.
+    * @param[out] triangles The projected triangles.
+    * @param[out] bins The triangles touching each tile, as indices into triangles.
+    */
+    void SetupInstance(const Instance &instance, std::vector<ScreenTriangle> &triangles, std::vector< std::vector<boost::uint32_t> > &bins) const;
+
+    /**
+    * Project a triangle which is entirely in front of the near plane and add it to the list if it is on screen and not degenerate.
+    * @param[in] a,b,c The corners in camera coordinates.
+    * @param[in,out] triangles The projected triangles.
+    */
+    void AddTriangle(const CameraVertex &a, const CameraVertex &b, const CameraVertex &c, std::vector<ScreenTriangle> &triangles) const;
+
+    /**
+    * Clear a tile and fill it with every triangle binned into it.
+    * @param[in] tile The index of the tile.
+    * @param[in] instances The instances being drawn.
+    * @param[out] labels The mask.
+    * @param[out] depth The depth image, or null if it isn't wanted.
+    * @param[out] normals The normal image, or null if it isn't wanted.
+    */
+    void DrawTile(const std::size_t tile, const std::vector<Instance> &instances, cv::Mat &labels, cv::Mat *depth, cv::Mat *normals);
+
+    const Camera &camera_; /**< The camera to project with. */
+    float near_clip_; /**< The depth of the near clip plane. */
+    int tiles_x_; /**< The number of tiles across the image. */
+    int tiles_y_; /**< The number of tiles down the image. */
+
+    std::vector<float> inverse_depth_; /**< The depth buffer, holding one over the depth of the nearest surface so far (0 is infinitely far). */
+    std::vector< std::vector<ScreenTriangle> > triangles_; /**< The projected triangles of each instance, kept between draws to reuse the storage. */
+    std::vector< std::vector< std::vector<boost::uint32_t> > > bins_; /**< The triangles of each instance touching each tile. */
+
+  };
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "session.hpp"
+#include "mask_rasterizer.hpp"
+
+namespace viz {
+
+  /**
+  * @class MaskRenderer
+  * @brief Draws part label masks, or full ground truth, for a whole session on the CPU.
+  * Loads the same config file as the interactive app, but without any OpenGL, then steps through the poses and saves a label mask and a binary mask
+  * for each eye as PNG sequences in the session's output directory. Part p of trackable n is labelled 4n + p + 1 (the parts of an instrument are the
+  * shaft, head and the two claspers) and the background is 0, the binary masks are 255 on any part. In ground truth mode the depth and surface normals are saved with the labels instead, see
+  * GroundTruthWriter. If the session sets distort-overlays the images are warped with the lens distortion so they line up with the raw frames, as the
+  * overlays are. This is for machines with no GPU, where software OpenGL would be far slower.
+  */
+  class MaskRenderer : public Session {
+
+  public:
+
+    /**
+    * Create a renderer. Doesn't need an OpenGL context.
+    * @param[in] ground_truth Save the depth, normals and labels of each eye rather than just the label masks.
+    */
+    explicit MaskRenderer(const bool ground_truth = false);
+
+    /**
+    * Load a session from a config file and draw the masks for all of its frames.
+    * @param[in] config_path The path to the app config file.
+    * @return The number of frames drawn.
+    */
+    size_t Run(const std::string &config_path);
+
+  protected:
+
+    /**
+    * Draw the label mask of the current frame's poses for one eye.
+    * @param[in] rasterizer The rasterizer for the eye.
+    * @param[in] world_to_eye The transform from world coordinates to the eye's coordinates.
+    * @param[out] labels The mask.
+    * @param[out] depth The depth image, or null if it isn't wanted.
+    * @param[out] normals The normal image, or null if it isn't wanted.
+    */
+    void drawMask(MaskRasterizer &rasterizer, const ci::Matrix44f &world_to_eye, cv::Mat &labels, cv::Mat *depth = 0, cv::Mat *normals = 0);
+
+    /**
+    * Warp an image drawn with the pinhole projection so it lines up with an eye's raw frames. Does nothing unless the session set up the distortion maps.
+    * @param[in] eye 0 for the left eye, 1 for the right.
+    * @param[in,out] image The image to warp.
+    */
+    void distort(const int eye, cv::Mat &image) const;
+
+    bool ground_truth_; /**< Save the depth and normals as well as the labels. */
+    cv::Mat distort_map_x_[2]; /**< The pinhole image column of each raw pixel for each eye, empty if the images aren't distorted. */
+    cv::Mat distort_map_y_[2]; /**< The pinhole image row of each raw pixel for each eye. */
+    std::vector<MaskRasterizer::Instance> instances_; /**< The parts to draw, kept between frames to reuse the storage. */
+
+  };
+
+}
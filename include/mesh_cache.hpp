@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/TriMesh.h>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+namespace viz {
+
+  /**
+  * @class MeshCache
+  * @brief A preprocessed binary copy of a mesh loaded from an OBJ file.
+  * The cache holds the vertex, normal, texture coordinate and color arrays and the index buffer exactly as they are laid out in a ci::TriMesh, so loading is a
+  * memory map and a copy of each array rather than parsing the OBJ text. It is written next to the OBJ file or, if that directory can't be written to,
+  * into a cache directory in the system temp directory. The cache stores a hash of the OBJ and MTL contents and is ignored if they change. Meshes
+  * derived from the source, such as decimated levels of detail, are cached in their own files alongside it.
+  */
+  class MeshCache {
+
+  public:
+
+    /**
+    * Hash the source files and work out where their cache can go.
+    * @param[in] obj_file The path to the OBJ file.
+    * @param[in] mtl_file The path to the material file loaded with it.
+    * @param[in] load_flags Anything else which changes the mesh loaded from the files (e.g. whether texture coordinates are loaded).
+    * @param[in] variant Empty for the mesh loaded from the files, or a name such as ".lod1" for a mesh derived from it.
+    */
+    MeshCache(const std::string &obj_file, const std::string &mtl_file, const boost::uint32_t load_flags, const std::string &variant = "");
+
+    /**
+    * Load the mesh from the cache if there is a valid one.
+    * @param[out] mesh The cached mesh.
+    * @return True if the mesh was loaded, false if there is no cache or it's for different source files.
+    */
+    bool Load(ci::TriMesh &mesh) const { float error; return Load(mesh, error); }
+
+    /**
+    * Load the mesh and the error it was saved with from the cache if there is a valid one.
+    * @param[out] mesh The cached mesh.
+    * @param[out] error How far a derived mesh is from the source mesh.
+    * @return True if the mesh was loaded, false if there is no cache or it's for different source files.
+    */
+    bool Load(ci::TriMesh &mesh, float &error) const;
+
+    /**
+    * Write the mesh to the cache. Failing to write it only prints a warning as the mesh can still be loaded from the OBJ file.
+    * @param[in] mesh The mesh loaded from the source files.
+    * @param[in] error How far a derived mesh is from the source mesh, 0 for the source mesh itself.
+    */
+    void Save(const ci::TriMesh &mesh, const float error = 0) const;
+
+  protected:
+
+    /**
+    * Load the mesh from one of the cache locations.
+    * @param[in] cache_path The cache file.
+    * @param[out] mesh The cached mesh.
+    * @param[out] error The error saved with it.
+    * @return True if the file exists and is valid for the source files.
+    */
+    bool LoadFrom(const std::string &cache_path, ci::TriMesh &mesh, float &error) const;
+
+    /**
+    * Write the mesh to one of the cache locations.
+    * @param[in] cache_path The cache file.
+    * @param[in] mesh The mesh to save.
+    * @param[in] error The error to save with it.
+    * @return True if the whole file was written.
+    */
+    bool SaveTo(const std::string &cache_path, const ci::TriMesh &mesh, const float error) const;
+
+    std::vector<std::string> cache_paths_; /**< The places the cache can be, in the order they are tried. */
+    boost::uint64_t source_hash_; /**< The FNV-1a hash of the source files and load flags. */
+
+  };
+
+}
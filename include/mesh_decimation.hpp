@@ -0,0 +1,38 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/TriMesh.h>
+
+namespace viz {
+
+  /**
+  * Reduce the number of triangles in a mesh with quadric error edge collapses (Garland and Heckbert). Each collapse moves one end of an edge onto the
+  * other, so the remaining vertices keep their normals, texture coordinates and colors. Collapses which would flip a triangle or make the mesh
+  * non-manifold are skipped, and open edges (including texture seams, where the mesh is split) are held in place by extra planes through them.
+  * @param[in] source The mesh to decimate.
+  * @param[in] target_triangles Stop once the mesh has this many triangles. It may end up with more if there are no more valid collapses.
+  * @param[out] decimated The decimated mesh.
+  * @return An upper bound on how far the decimated surface is from the source surface, in the mesh units.
+  */
+  float DecimateMesh(const ci::TriMesh &source, const std::size_t target_triangles, ci::TriMesh &decimated);
+
+}
@@ -26,6 +26,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cinder/gl/Texture.h>
 #include <cinder/Json.h>
 
+#include "asset_cache.hpp"
+
 namespace viz {
 
   /**
@@ -43,6 +45,12 @@ namespace viz {
     */
     virtual void Draw() const = 0;
 
+    /**
+    * Draw the model with a set of transforms (in the order given by GetTransformSet()) rather than the current pose. Assumes that an OpenGL context is available for the active thread.
+    * @param[in] transforms The transform for each part of the model.
+    */
+    virtual void Draw(const std::vector<ci::Matrix44f> &transforms) const = 0;
+
     /**
     * Load the data for the model from a config file.
     * @param[in] datafile_path The full path to the configuration file.
@@ -56,13 +64,21 @@ namespace viz {
     virtual std::vector<ci::Matrix44f> GetTransformSet() const = 0;
     virtual void SetTransformSet(const std::vector<ci::Matrix44f> &transforms) = 0;
 
+    /**
+    * Get the full resolution mesh of each part, in the same order as GetTransformSet(). Used to draw the model on the CPU.
+    * @return The meshes, null for any part which hasn't been loaded.
+    */
+    virtual std::vector< boost::shared_ptr<const ci::TriMesh> > GetMeshes() const = 0;
+
   protected:
 
 
     struct RenderData {
-      ci::TriMesh model_; /**< The 3D mesh that the model represents. */
-      ci::gl::VboMesh	vbo_; /**< VBO to store the model for faster drawing. */
-      ci::gl::Texture texture_; /**< The texture for the model. */
+      boost::shared_ptr<const ci::TriMesh> model_; /**< The 3D mesh that the model represents, shared with any other model loaded from the same file. */
+      ci::gl::VboMesh	vbo_; /**< VBO to store the model for faster drawing. Shared like model_. */
+      ci::gl::Texture texture_; /**< The texture for the model. Shared like model_. */
+      ci::Sphere bounds_; /**< A sphere around the mesh in model coordinates, used to work out how big it is on screen. */
+      std::vector< boost::shared_ptr<const AssetCache::Mesh> > levels_of_detail_; /**< Decimated copies of the mesh, coarsest last. Shared like model_. */
       ci::Matrix44f transform_; /**< The transform from world coordinates to the model coordinate system. */
     };
 
@@ -71,12 +87,42 @@ namespace viz {
     * Draw a single RenderData model
     * @param[in] rd The model to draw.
     */
-    void InternalDraw(const RenderData &rd, const float inc=0) const;
+    void InternalDraw(const RenderData &rd, const float inc=0) const { InternalDraw(rd, rd.transform_, inc); }
+
+    /**
+    * Draw a single RenderData model with a different transform to the one it stores.
+    * @param[in] rd The model to draw.
+    * @param[in] transform The transform from world coordinates to the model coordinate system.
+    */
+    void InternalDraw(const RenderData &rd, const ci::Matrix44f &transform, const float inc=0) const;
+
+    /**
+    * Choose the coarsest level of detail which is within a pixel of the full mesh at the size the model is drawn.
+    * @param[in] rd The model to draw.
+    * @param[in] transform The model transform on top of the current modelview, identity if it's already on the modelview.
+    * @return The vertex buffer to draw.
+    */
+    const ci::gl::VboMesh &SelectLevelOfDetail(const RenderData &rd, const ci::Matrix44f &transform = ci::Matrix44f::identity()) const;
 
     ci::JsonTree OpenFile(const std::string &datafile_path) const;
     
     void LoadComponent(const ci::JsonTree &tree, RenderData &target, const std::string &root_dir);
 
+    /**
+    * Get the files for a component from the model's config file, checking they exist.
+    * @param[in] tree The component's entry in the config file.
+    * @param[in] root_dir The directory the file paths are relative to.
+    * @return The files for the asset cache.
+    */
+    AssetCache::Request ComponentFiles(const ci::JsonTree &tree, const std::string &root_dir) const;
+
+    /**
+    * Point a component at its mesh and texture in the asset cache. They must already have been loaded.
+    * @param[in] files The component's files.
+    * @param[out] target The component.
+    */
+    void AssignComponent(const AssetCache::Request &files, RenderData &target) const;
+
   };
 
   class Model : public BaseModel {
@@ -84,10 +130,12 @@ namespace viz {
   public:
 
     virtual void Draw() const;
+    virtual void Draw(const std::vector<ci::Matrix44f> &transforms) const;
     virtual void LoadData(const std::string &datafile_path);
 
     virtual std::vector<ci::Matrix44f> GetTransformSet() const;
     virtual void SetTransformSet(const std::vector<ci::Matrix44f> &transforms);
+    virtual std::vector< boost::shared_ptr<const ci::TriMesh> > GetMeshes() const;
 
     RenderData &Body() { return body_; }
     const RenderData &Body() const { return body_; }
@@ -98,12 +146,24 @@ namespace viz {
 
   };
 
+  /**
+  * @class DaVinciInstrument
+  * @brief A da Vinci instrument made of a shaft, head and two claspers which move independently.
+  * When a shader is bound the parts are drawn from a single packed vertex buffer in one draw call, with each part's transform passed as a uniform.
+  */
   class DaVinciInstrument : public BaseModel {
 
   public:
 
     virtual void Draw() const;
 
+    /**
+    * Draw the instrument with a transform for each part. If a shader is bound (i.e. this is a shaded pass) and the parts could be packed, this is a
+    * single draw call with its own shader, otherwise each part is drawn separately. The bound shader is restored afterwards.
+    * @param[in] transforms The shaft, head, left clasper and right clasper transforms.
+    */
+    virtual void Draw(const std::vector<ci::Matrix44f> &transforms) const;
+
 	void DrawBody() const;
 	void DrawLeftClasper() const;
 	void DrawRightClasper() const;
@@ -113,6 +173,7 @@ namespace viz {
 
     virtual std::vector<ci::Matrix44f> GetTransformSet() const;
     virtual void SetTransformSet(const std::vector<ci::Matrix44f> &transforms);
+    virtual std::vector< boost::shared_ptr<const ci::TriMesh> > GetMeshes() const;
 
     RenderData &Shaft() { return shaft_; }
     RenderData &Head() { return head_; }
@@ -126,11 +187,28 @@ namespace viz {
 
   protected:
 
+    /**
+    * Pack the meshes of the four parts into packed_vbos_, tagging each vertex with its part in the vertex color. There is a packed buffer for the full
+    * meshes and for each level of detail all the parts have. Leaves packed_vbos_ empty if the parts don't all have normals and texture coordinates.
+    * @param[in] cache_key Identifies the set of parts, so the buffers are built once and shared by every instrument made of the same parts.
+    */
+    void PackParts(const std::string &cache_key);
+
+    /**
+    * Draw the parts from packed_vbos_ in a single call, at the coarsest level of detail which is within a pixel of the full meshes.
+    * @param[in] transforms The transform for each part.
+    * @return False if the packed drawing isn't available, in which case nothing is drawn.
+    */
+    bool DrawPacked(const std::vector<ci::Matrix44f> &transforms) const;
+
     RenderData shaft_;
     RenderData head_;
     RenderData clasper1_;
     RenderData clasper2_;
 
+    std::vector<ci::gl::VboMesh> packed_vbos_; /**< All four parts in one vertex buffer for each level of detail, each vertex's color is a one-hot vector giving its part. */
+    std::vector<float> packed_errors_; /**< The largest error of any part in each packed level of detail. */
+
   };
 
 
@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace viz {
+
+  /**
+  * @class OffscreenContext
+  * @brief A software (OSMesa) OpenGL context which doesn't need a window, display or GPU.
+  * The context is current for the lifetime of the object. Rendering is expected to go to framebuffer objects, the default framebuffer is just big
+  * enough to make the context current.
+  */
+  class OffscreenContext : boost::noncopyable {
+
+  public:
+
+    /**
+    * Create the context and make it current. Throws if OSMesa can't create it.
+    * @param[in] width The width of the default framebuffer.
+    * @param[in] height The height of the default framebuffer.
+    */
+    OffscreenContext(const int width, const int height);
+
+    /**
+    * Destroy the context.
+    */
+    ~OffscreenContext();
+
+  protected:
+
+    void *context_; /**< The OSMesaContext, kept opaque so this header doesn't pull in the Mesa GL headers. */
+    std::vector<unsigned char> buffer_; /**< The memory backing the default framebuffer. */
+
+  };
+
+}
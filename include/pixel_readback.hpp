@@ -0,0 +1,82 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <opencv2/core/core.hpp>
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Fbo.h>
+#include <cinder/gl/Vbo.h>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace viz {
+
+  /**
+  * @class PixelReadback
+  * @brief Reads the contents of framebuffers back to the CPU without stalling the GPU.
+  * Each read is copied into one of a ring of pixel buffer objects and only mapped a few frames later, by which time the copy has finished, so the
+  * following frames render while the earlier ones are read back. Frames come out in the order they were read, the right way up for OpenCV.
+  */
+  class PixelReadback : boost::noncopyable {
+
+  public:
+
+    /**
+    * Allocate the pixel buffers. Needs a current OpenGL context.
+    * @param[in] width The width of the framebuffers that will be read.
+    * @param[in] height The height of the framebuffers that will be read.
+    * @param[in] num_buffers The number of reads that can be in flight, 2 for double buffering or 3 for triple buffering.
+    */
+    PixelReadback(const int width, const int height, const std::size_t num_buffers = 3);
+
+    /**
+    * Start reading a framebuffer. If this fills the ring the oldest read is finished to make room.
+    * @param[in] framebuffer The framebuffer to read, it must be the size the readback was created with.
+    * @param[out] frame The oldest frame (8 bit BGR), if a read was finished.
+    * @return True if frame was filled in.
+    */
+    bool Read(ci::gl::Fbo &framebuffer, cv::Mat &frame);
+
+    /**
+    * Finish the oldest read, waiting for it if it's not done yet. Call this until it returns false to get the last frames.
+    * @param[out] frame The oldest frame (8 bit BGR).
+    * @return False if there were no reads in flight.
+    */
+    bool Finish(cv::Mat &frame);
+
+    /**
+    * Get the number of reads which haven't been finished.
+    * @return The number of reads in flight.
+    */
+    std::size_t Pending() const { return pending_; }
+
+  protected:
+
+    int width_; /**< The width of the frames. */
+    int height_; /**< The height of the frames. */
+
+    std::vector<ci::gl::Vbo> buffers_; /**< The ring of pixel pack buffers. */
+    std::size_t next_; /**< The buffer the next read goes into. */
+    std::size_t pending_; /**< The number of buffers holding reads which haven't been finished. */
+
+  };
+
+}
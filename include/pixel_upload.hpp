@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <opencv2/core/core.hpp>
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Texture.h>
+#include <cinder/gl/Vbo.h>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace viz {
+
+  /**
+  * @class PixelUpload
+  * @brief Streams frames into a texture through pixel buffer objects.
+  * Each frame is copied into the next of a ring of pixel unpack buffers and the texture is updated from there, so glTexSubImage2D returns
+  * straight away and the transfer to the GPU overlaps with drawing. The texture is only allocated again if the frame size changes.
+  */
+  class PixelUpload : boost::noncopyable {
+
+  public:
+
+    /**
+    * Create an empty upload. The pixel buffers are allocated on the first upload, so this doesn't need an OpenGL context.
+    * @param[in] num_buffers The number of frames that can be in flight to the GPU.
+    */
+    explicit PixelUpload(const std::size_t num_buffers = 3) : num_buffers_(num_buffers > 0 ? num_buffers : 1), buffer_size_(0), next_(0) {}
+
+    /**
+    * Copy a frame into a texture.
+    * @param[in] frame An 8 bit BGR frame.
+    * @param[in,out] texture The texture to update. Allocated if it's empty or the wrong size.
+    */
+    void Upload(const cv::Mat &frame, ci::gl::Texture &texture);
+
+  protected:
+
+    std::size_t num_buffers_; /**< The number of buffers in the ring. */
+    std::size_t buffer_size_; /**< The size of each buffer in bytes. */
+    std::vector<ci::gl::Vbo> buffers_; /**< The ring of pixel unpack buffers. */
+    std::size_t next_; /**< The buffer the next frame is copied into. */
+
+  };
+
+}
@@ -82,6 +82,24 @@ namespace viz {
     */
     virtual void Draw() const = 0;
 
+    /**
+    * Renders the model with transforms saved by GetModelTransforms() rather than the current pose. Assumes OpenGL context is available on current thread.
+    * @param[in] model_transforms The transform of each part of the model.
+    */
+    virtual void Draw(const std::vector<ci::Matrix44f> &model_transforms) const = 0;
+
+    /**
+    * Get the transforms of each part of the model at the current pose, so the model can be drawn at this pose after the next one has been loaded.
+    * @return The model transforms.
+    */
+    virtual std::vector<ci::Matrix44f> GetModelTransforms() const = 0;
+
+    /**
+    * Get the mesh of each part of the model, in the same order as GetModelTransforms(), to draw the model without OpenGL.
+    * @return The meshes, null for any part without one.
+    */
+    virtual std::vector< boost::shared_ptr<const ci::TriMesh> > GetModelMeshes() const = 0;
+
     /**
     * Get the poses from the previous frames to draw past trajectories.
     * @return A vector of all previous frame's poses.
@@ -96,7 +114,43 @@ namespace viz {
 
     ci::params::InterfaceGlRef ParamModifier() { return param_modifier_; }
 
+    /**
+    * Move the pose streams so that the next LoadPose(true) reads the pose for a specific frame. Positions of frames which have already been read are cached 
+    * so seeking backwards is a file seek, seeking past the furthest frame read so far reads forward to it. The trajectory history is truncated to the new position.
+    * @param[in] frame The frame index to seek to.
+    * @return True if the seek succeeded, false if there are not that many poses in the file.
+    */
+    virtual bool Seek(const std::size_t frame);
+
   protected:
+
+    /**
+    * Get the file streams which the poses are read from. Used to save and restore stream positions when seeking.
+    * @return The input streams, in a fixed order.
+    */
+    virtual std::vector<std::ifstream *> PoseStreams() = 0;
+
+    /**
+    * @struct FramePosition
+    * @brief Where a frame's poses start in the pose streams and how long the trajectory was before the frame was read.
+    */
+    struct FramePosition {
+      std::vector<std::streampos> stream_positions; /**< The position of each pose stream, in the order of PoseStreams(). */
+      std::size_t history_size; /**< The length of reference_frame_tracks_, which the trajectory is cut back to when seeking to the frame. */
+    };
+
+    /**
+    * Get the current position of the pose streams and the length of the trajectory. Must be called by LoadPose() before it reads a new pose.
+    * @return The position.
+    */
+    FramePosition CurrentFramePosition();
+
+    /**
+    * Save the position of the frame that has just been read and move on to the next one. Must be called by LoadPose() once a new pose has been read
+    * successfully, so a failed read doesn't advance the frame.
+    * @param[in] position The position from CurrentFramePosition() before the pose was read.
+    */
+    void RecordFramePosition(const FramePosition &position);
     
     void checkSelfName(const std::string &test_name) const { if (test_name != self_name_) throw std::runtime_error(""); }
 
@@ -110,6 +164,9 @@ namespace viz {
 
     std::vector<ci::Matrix44f> reference_frame_tracks_; /**< Keeps track of previous SE3s to represent the model for plotting trajectories across 3D space. For articulated bodies this should be the 'global' pose of the object. */
 
+    std::vector<FramePosition> frame_positions_; /**< The start of each frame that has been read. */
+    std::size_t next_frame_; /**< The index of the frame the next LoadPose(true) reads. */
+
     std::string self_name_;
 
     std::string save_dir_;
@@ -158,9 +215,17 @@ namespace viz {
     */
     virtual void Draw() const { model_.Draw(); }
 
+    virtual void Draw(const std::vector<ci::Matrix44f> &model_transforms) const { model_.Draw(model_transforms); }
+
+    virtual std::vector<ci::Matrix44f> GetModelTransforms() const { return model_.GetTransformSet(); }
+
+    virtual std::vector< boost::shared_ptr<const ci::TriMesh> > GetModelMeshes() const { return model_.GetMeshes(); }
+
     virtual ~PoseGrabber() { if (ifs_.is_open()) ifs_.close(); if (ofs_.is_open()) ofs_.close(); }
 
   protected:
+
+    virtual std::vector<std::ifstream *> PoseStreams() { return std::vector<std::ifstream *>(1, &ifs_); }
     
     std::ifstream ifs_; /**< The file stream containing the SE3 transforms for each frame. */
     
@@ -203,6 +268,12 @@ namespace viz {
     */
     virtual void Draw() const { model_.Draw(); }
 
+    virtual void Draw(const std::vector<ci::Matrix44f> &model_transforms) const { model_.Draw(model_transforms); }
+
+    virtual std::vector<ci::Matrix44f> GetModelTransforms() const { return model_.GetTransformSet(); }
+
+    virtual std::vector< boost::shared_ptr<const ci::TriMesh> > GetModelMeshes() const { return model_.GetMeshes(); }
+
   protected:
     virtual void SetOffsetsToNull() = 0;
 
@@ -281,6 +352,8 @@ namespace viz {
 
   protected:
 
+    virtual std::vector<std::ifstream *> PoseStreams();
+
     /**
     * Read the DH values from the files and store them in the vectors.
     * @param[in] base_offsets The default base offsets to start with (if we've computed them before and want to start playing around with a better estimate.
@@ -370,6 +443,8 @@ namespace viz {
 
   protected:
 
+    virtual std::vector<std::ifstream *> PoseStreams() { return std::vector<std::ifstream *>(1, &ifs_); }
+
     enum LoadType {QUATERNION, MATRIX, EULER};
     LoadType rotation_type_;
 
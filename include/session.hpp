@@ -0,0 +1,325 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Fbo.h>
+#include <cinder/gl/Texture.h>
+#include <cinder/gl/GlslProg.h>
+#include <cinder/MayaCamUI.h>
+
+#include "camera.hpp"
+#include "config_reader.hpp"
+#include "pose_grabber.hpp"
+#include "video.hpp"
+#include "pixel_upload.hpp"
+#include "trajectory_buffer.hpp"
+#include "distorted_overlay.hpp"
+#include "stereo_pass.hpp"
+#include "core_renderer.hpp"
+
+namespace viz {
+
+  /**
+  * @struct State
+  * @brief Simple container to represent the state of the application.
+  */
+ 
+  struct State {
+
+    bool save_all; /**< Flag to save all frames and data. */
+    bool save_one; /**< Flag to save the next loaded frame and data. */
+
+    bool load_all; /**< Flag to load all frames and data without stopping. */
+    bool load_one; /**< Flag to save just the next frame and data. */
+
+  };
+
+  /**
+  * @struct FramePoses
+  * @brief The poses of everything drawn in a frame.
+  * The views are drawn from this copy rather than from the pose grabbers, so a frame can still be drawn after the grabbers have moved on to the next one.
+  */
+  struct FramePoses {
+
+    ci::Matrix44f camera_pose; /**< The pose the eye views are drawn from. */
+    ci::Matrix44f moveable_camera_pose; /**< The pose of the moveable camera, if there is one. */
+    ci::Matrix44f tracked_camera_pose; /**< The pose of the tracked camera, if there is one. */
+    std::vector<ci::Matrix44f> trackable_poses; /**< The pose of each trackable. */
+    std::vector< std::vector<ci::Matrix44f> > trackable_transforms; /**< The transform of each part of each trackable's model. */
+    std::vector<ci::Matrix44f> moveable_camera_history; /**< The trajectory of the moveable camera up to this frame. */
+    std::vector<ci::Matrix44f> tracked_camera_history; /**< The trajectory of the tracked camera up to this frame. */
+
+  };
+
+  /**
+  * @class Session
+  * @brief A loaded visualization session without any user interface.
+  * Holds the videos, camera and trackables loaded from a config file, advances them frame by frame and draws the eye and 3D views into whichever
+  * framebuffer is bound. It needs a current OpenGL context but not a window, so it is shared by the interactive app and the headless batch renderer.
+  */
+  class Session {
+
+  public:
+
+    /**
+    * Create an empty session. Nothing is loaded until setupFromConfig() is called.
+    */
+    Session();
+
+    /**
+    * Virtual destructor for derived front ends.
+    */
+    virtual ~Session() {}
+
+  protected:
+
+    /**
+    * Load the next frame of video and poses (if loading is switched on) and upload the video frames.
+    */
+    void advanceFrame();
+
+    void updateModels();
+    void updateVideo();
+
+    /**
+    * Load the pose of the cameras and each of the trackables.
+    * @param[in] load_new Read the next pose from the pose files rather than just refreshing the current one.
+    * @return False if any of the pose files has run out of poses.
+    */
+    bool loadPoses(const bool load_new);
+
+    /**
+    * Copy the current poses of the cameras and trackables. The trajectories are only appended to unless they have been truncated by a seek.
+    * @param[in,out] poses The copy to update.
+    * @param[in] with_history Also update the camera trajectories, otherwise they are left as they are.
+    */
+    void capturePoses(FramePoses &poses, const bool with_history = true);
+
+    /**
+    * Read the next pair of frames from whichever videos are open. If no video is open the frames are left empty.
+    * @param[out] left_frame The left frame.
+    * @param[out] right_frame The right frame.
+    * @return False if the end of the video has been reached.
+    */
+    bool readFrames(cv::Mat &left_frame, cv::Mat &right_frame);
+
+    /**
+    * Get a frame ready to upload by removing the lens distortion if that's switched on, resizing it to the calibrated size first as that's the size the
+    * maps are built for. Without undistortion the frame is uploaded at its own size, so proxy frames stay small, and draw2D() scales it.
+    * @param[in] frame The frame from readFrames(), a black frame is used if it's empty.
+    * @param[in] camera The camera the frame came from.
+    * @param[in,out] resize_buffer Storage for the resized frame.
+    * @param[in,out] undistort_buffer Storage for the undistorted frame.
+    * @return The prepared frame, which may be frame itself or one of the buffers.
+    */
+    const cv::Mat &prepareFrame(cv::Mat &frame, const Camera &camera, cv::Mat &resize_buffer, cv::Mat &undistort_buffer);
+
+    /**
+    * Switch the input videos between the proxy and full resolution. The proxy is only used for previewing, whenever we are saving the full resolution
+    * video is decoded.
+    */
+    void updateProxy();
+
+    /**
+    * Move the video and all of the pose streams to a frame and load it, keeping them aligned. If any of them can't get there they all go back to
+    * the video's previous position.
+    * @param[in] frame The frame index to seek to.
+    */
+    void seekToFrame(const size_t frame);
+
+    /**
+    * Seek the video and every pose stream to a frame, carrying on with the rest if one fails.
+    * @param[in] frame The frame index to seek to.
+    * @return True if all of them got there.
+    */
+    bool seekStreams(const size_t frame);
+
+    /**
+    * Create a visualization environment from a configuration file. To see an example configuration file, see config/app.cfg.
+    * @param[in] path The path to the config file.
+    */
+    void setupFromConfig(const std::string &path);
+    
+    /**
+    * Save a frame and the current tracked object poses (useful if they have been modified within the GUI).
+    */
+    void savePoses();
+
+    /**
+    * Draw a grid on the ground plane. 
+    * @param[in] size The size of the grid.
+    * @param[in] step The length of each grid square.
+    * @param[in] plane_position The vertical position of the plane.
+    */
+    void drawGrid(float size = 3.9, float step = 0.3, float plane_position = 0.0);
+
+    /**
+    * Call the draw method on all of the trackable targets.
+    */
+    void drawTargets();
+
+    /**
+    * Draw the visualization for either the left or right eye. This corresponds to drawing the camera view and the positions of the instruments in front of the camera.
+    * @param[in] texture The background image (i.e. what the camera captured).
+    * @param[in] is_left Flag to set whether the camera is the left or right one.
+    */
+    void drawEye(ci::gl::Texture &texture, bool is_left);
+
+    /**
+    * Draw both eye views at once with the single pass stereo renderer, each mesh is only sent to the GPU once for both eyes. Copy the views out with
+    * drawEyeFromStereo().
+    */
+    void drawEyesSinglePass();
+
+    /**
+    * Copy an eye view drawn by drawEyesSinglePass() into the bound framebuffer.
+    * @param[in] is_left Flag to set whether to copy the left or right view.
+    */
+    void drawEyeFromStereo(bool is_left);
+
+    /**
+    * Check if the eye views are drawn with the single pass stereo renderer. It's switched on with single-pass-stereo in the config, and isn't used with
+    * distorted overlays as they need a separate pass per eye anyway.
+    * @return True if drawEyesSinglePass() should be used instead of drawEye().
+    */
+    bool useSinglePassStereo() const { return stereo_pass_.IsSetup() && !left_overlay_.IsSetup(); }
+
+    /**
+    * Draw the 3D scene with the camera and trackable targets from a observer viewpoint.
+    * @param[in] left_image The current left camera frame, is draw onto the camera model in the 3D viewer.
+    * @param[in] right_image The current right camera frame, is draw onto the camera model in the 3D viewer.
+    */
+    void drawScene(ci::gl::Texture &left_image, ci::gl::Texture &right_image);
+
+    /**
+    * Draw the camera view onto the viewport.
+    * @param[in] image The camera view.
+    * @param[in] viewport_x Where the view starts along the target, for drawing side by side views.
+    */
+    void draw2D(ci::gl::Texture &image, const int viewport_x = 0);
+
+    /** 
+    * Draw a 3D model of a camera with it's view mapped onto it's image plane.
+    * @param[in] left_image The left image viewed by the camera.
+    * @param[in] right_image The right image viewed by the camera.
+    */
+    void drawCamera(ci::gl::Texture &left_image, ci::gl::Texture &right_image);
+
+    /**
+    * Actually map the image onto the camera image plane.
+    * @param[in] image_data The image viewed by the camera.
+    * @param[in] tl The 3D coordinates of the top left corner of the camera view.
+    * @param[in] bl The 3D coordinates of the top bottom corner of the camera view.
+    * @param[in] tr The 3D coordinates of the top left right of the camera view.
+    * @param[in] br The 3D coordinates of the top bottom right of the camera view.
+    */
+    void drawImageOnCamera(ci::gl::Texture &image_data, ci::Vec3f &tl, ci::Vec3f &bl, ci::Vec3f &tr, ci::Vec3f &br);
+
+    /**
+    * Draw the trajectory of the tracked object as a set of minimal representations of it's pose at each frame.
+    * @param[in] transforms The 6 DOF poses the object took at each frame.
+    * @param[in,out] buffer The GPU copy of this trajectory, the new poses are appended to it.
+    * @param[in] color The color of the trajectory.
+    */
+    void drawTrajectories(const std::vector<ci::Matrix44f> &transforms, TrajectoryBuffer &buffer, ci::Color &color);
+
+    /**
+    * Draw the trajectories of a tracked camera and the ground truth.
+    */
+    void drawCameraTracker();
+    
+    /**
+    * Load one of the trackables.
+    * @param[in] reader The ConfigReader which has the location of the config file for this trackable.
+    * @param[in] output_dir_this_run Create a new output directory for the trackables.
+    */
+    void loadTrackables(const ConfigReader &reader, const std::string &output_dir_this_run);
+
+    /**
+    * Wrapper to get the current camera pose. If we have loaded a moveable camera then return its pose, if not then return the identity transform.
+    * @return The current camera pose as a 4x4 matrix.
+    */
+    ci::Matrix44f getCameraPose();
+
+    /**
+    * Load a single trackable. Called by loadTrackables().
+    * @param[in] filepath The path to the config file for this trackable.
+    * @param[in] output_dir The directory where any output for this trackable should be saved.
+    */
+    void loadTrackable(const std::string &filepath, const std::string &ouput_dir);
+
+    State state;
+    
+    bool running_;
+
+    VideoIO video_left_; /**< The left video IO device. Reads input frames and saves the frames with the corresponding output save on top. */
+    VideoIO video_right_;  /**< The right video IO device. Reads input frames and saves the frames with the corresponding output save on top. */
+    VideoIO stereo_video_;
+
+    StereoCamera camera_; /**< The physical camera device which models the actual camera which views the scene. Handles projection the models into the image plane of the camera with physically realistic results. */
+
+    ci::gl::Texture left_texture_; /**< The current left camera view */
+    ci::gl::Texture right_texture_; /**< The current right camera view */
+    PixelUpload left_upload_; /**< Streams the left camera frames into left_texture_. */
+    PixelUpload right_upload_; /**< Streams the right camera frames into right_texture_. */
+    std::size_t frame_generation_; /**< Incremented whenever new camera frames are uploaded, so the views can tell when the images have changed. */
+    cv::Mat left_resize_buffer_; /**< Storage for resizing the left camera view when it doesn't match the calibration size. */
+    cv::Mat right_resize_buffer_; /**< Storage for resizing the right camera view when it doesn't match the calibration size. */
+    cv::Mat left_undistort_buffer_; /**< Storage for the undistorted left camera view. */
+    cv::Mat right_undistort_buffer_; /**< Storage for the undistorted right camera view. */
+    ci::gl::Fbo framebuffer_; /**< The framebuffer to hold the drawing for the 'eye' views. */
+    ci::gl::Fbo framebuffer_3d_; /**< The framebuffer to the hold the drawing for the 3D view. */
+    DistortedOverlay left_overlay_; /**< Draws the left eye's models with its lens distortion when the raw video is shown, if distort-overlays is set. */
+    DistortedOverlay right_overlay_; /**< Draws the right eye's models with its lens distortion. */
+    StereoPass stereo_pass_; /**< Draws both eye views in one pass, if single-pass-stereo is set and the driver supports it. */
+    CoreRenderer core_renderer_; /**< Draws the models in the eye views from uniform buffers and vertex arrays, if core-renderer is set and the driver supports it. */
+
+    ci::MayaCamUI maya_cam_2_;
+    ci::MayaCamUI maya_cam_; /**< The framebuffer to the hold the drawing for the 3D view. */
+
+    std::vector< boost::shared_ptr<BasePoseGrabber> > trackables_; /**< The set of trackable objects to draw on the views. */
+    FramePoses frame_poses_; /**< The poses the views are drawn with, captured from the pose grabbers when a frame is loaded. */
+    TrajectoryBuffer moveable_camera_trajectory_; /**< The moveable camera's trajectory on the GPU. */
+    TrajectoryBuffer tracked_camera_trajectory_; /**< The tracked camera's trajectory on the GPU. */
+    boost::shared_ptr<BasePoseGrabber> moveable_camera_; /**< A possibly movable camera too. If this isn't set then the identity camera transform is used (leaving the camera always at the origin). */
+    boost::shared_ptr<BasePoseGrabber> tracked_camera_; /**< If we are tracking the possibly moveable camera then we can visualize how the tracking performance was with this object. */
+    
+    ci::gl::GlslProg shader_; /**< Shader to draw the models more nicely than with the fixed-pipeline drawing. */
+
+    size_t camera_image_width_; /**< The image width we are loading from the camera. */
+    size_t camera_image_height_; /**< The image height we are loading from the camera. */
+    size_t three_dim_viz_width_; /**< The width of the 3D visualizer window. */
+    size_t three_dim_viz_height_; /**< The width of the 3D visualizer window. */
+
+    bool reset_viz_port_; /**< Flag to reset the vizport if we move the MayaCam too far away. */
+
+    bool proxy_preview_; /**< Preview with the reduced resolution proxy videos when they are ready. */
+
+    std::string output_directory_; /**< The directory this run's outputs are saved to. */
+    std::string save_format_; /**< How saved views are written, "avi" or "png". */
+    int png_compression_; /**< The zlib compression level (0-9) for PNG output. */
+    bool headless_; /**< Load the session without touching OpenGL, for front ends which only draw on the CPU. Set before setupFromConfig(). */
+    bool interactive_; /**< The session is previewed and seeked in a window, so the frame cache and proxy videos are worth building. Set before setupFromConfig(). */
+
+  };
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <string>
+
+namespace viz {
+
+  /**
+  * Get the GLSL for the phong lighting of resources/phong_frag.glsl as a function, so the shaders built in code all light the models the same way.
+  * Declares vec4 phongLighting(vec3 v, vec3 N, vec3 light_position), which takes the fragment position, normal and light position in eye
+  * coordinates and returns the lighting to multiply the texel by.
+  * @return The GLSL source, to go after the #version line.
+  */
+  std::string PhongLightingSnippet();
+
+  /**
+  * Get the GLSL for texturing packed instruments, where each of the four parts has its own texture. Declares the samplers tex0 to tex3 and
+  * vec4 partTexel(vec4 part_weights, vec2 st), which picks out the part's texture with the one-hot part weights rather than indexing a sampler array.
+  * @return The GLSL source, to go after the #version line.
+  */
+  std::string PartTextureSnippet();
+
+}
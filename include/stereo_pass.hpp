@@ -0,0 +1,138 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Fbo.h>
+#include <cinder/gl/Vbo.h>
+#include <cinder/gl/GlslProg.h>
+#include <cinder/Matrix.h>
+#include <string>
+
+namespace viz {
+
+  /**
+  * @class StereoPass
+  * @brief Draws the models into both eye views in a single pass.
+  * The two eyes are drawn side by side into one framebuffer. Each mesh is drawn once as two instances, and the vertex shader moves the second
+  * instance into the right eye and shifts each into its half of the target, with clip planes keeping it there. The fixed function matrices and
+  * lights are those of the left eye, the shader gets the transform to the right eye as a uniform. Shaders used during the pass are built from
+  * ShaderPrologue(), which provides projectToEye() and lightPosition() so the same shader body works with or without the stereo pass.
+  */
+  class StereoPass {
+
+  public:
+
+    StereoPass() : previous_framebuffer_(0) {}
+
+    /**
+    * Check if the driver supports instanced drawing and framebuffer blits, which the pass needs.
+    * @return True if the pass can be used.
+    */
+    static bool IsSupported();
+
+    /**
+    * Create the side by side target and the stereo shader. Needs a current OpenGL context.
+    * @param[in] eye_width The width of each eye's view.
+    * @param[in] eye_height The height of each eye's view.
+    */
+    void Setup(const int eye_width, const int eye_height);
+
+    /**
+    * Check if Setup() has succeeded.
+    * @return True if the pass can be drawn.
+    */
+    bool IsSetup() const { return framebuffer_ && shader_; }
+
+    /**
+    * Switch to the side by side target and clear it, the previous framebuffer is remembered.
+    */
+    void Begin();
+
+    /**
+    * Set up for drawing the models into both eyes. The left eye's camera should already be set up. Sets the viewport to cover both eyes and binds
+    * the stereo shader, and meshes drawn with Draw() are drawn into both eyes until EndModels().
+    * @param[in] left_to_right The transform from the left eye's OpenGL coordinates to the right eye's.
+    * @param[in] right_projection The right eye's projection matrix.
+    * @param[in] light_position The light position in the left eye's OpenGL coordinates.
+    */
+    void BeginModels(const ci::Matrix44f &left_to_right, const ci::Matrix44f &right_projection, const ci::Vec3f &light_position);
+
+    /**
+    * Stop drawing models into both eyes.
+    */
+    void EndModels();
+
+    /**
+    * Switch back to the framebuffer which was bound when Begin() was called.
+    */
+    void End();
+
+    /**
+    * Copy one eye's view into the bound framebuffer, which should be the size of an eye.
+    * @param[in] is_left Copy the left eye rather than the right.
+    */
+    void CopyEye(const bool is_left) const;
+
+    /**
+    * Set the uniforms ShaderPrologue() declares for the stereo pass on a shader which has just been bound.
+    * @param[in] shader The shader.
+    */
+    void SetUniforms(ci::gl::GlslProg &shader) const;
+
+    /**
+    * Get the pass which is drawing models, if there is one.
+    * @return The pass between BeginModels() and EndModels(), otherwise null.
+    */
+    static const StereoPass *Current() { return current_; }
+
+    /**
+    * Draw a mesh, into both eyes if a stereo pass is drawing models.
+    * @param[in] vbo The mesh.
+    */
+    static void Draw(const ci::gl::VboMesh &vbo);
+
+    /**
+    * Get the start of a GLSL 1.20 shader which works with or without the stereo pass. Vertex shaders get
+    * vec4 projectToEye(inout vec4 eye_vertex, inout vec3 eye_normal), which takes a vertex and normal in the left eye's coordinates, moves them into the
+    * eye being drawn and returns the clip position. Fragment shaders get vec3 lightPosition(), the light in the eye being drawn.
+    * @param[in] vertex Get the vertex shader prologue rather than the fragment shader one.
+    * @param[in] stereo Get the prologue for the stereo pass.
+    * @return The GLSL source, starting with the #version.
+    */
+    static std::string ShaderPrologue(const bool vertex, const bool stereo);
+
+  protected:
+
+    ci::gl::Fbo framebuffer_; /**< Both eyes side by side, the left eye on the left. */
+    ci::gl::GlslProg shader_; /**< The phong shader for the stereo pass. */
+    ci::Matrix44f left_to_right_; /**< The transform from the left eye's coordinates to the right eye's. */
+    ci::Matrix44f right_projection_; /**< The right eye's projection. */
+    ci::Vec3f light_positions_[2]; /**< The light position in each eye's coordinates. */
+    GLint previous_framebuffer_; /**< The framebuffer bound when Begin() was called. */
+    GLint previous_program_; /**< The shader bound when BeginModels() was called. */
+    GLint previous_viewport_[4]; /**< The viewport when BeginModels() was called. */
+
+    static const StereoPass *current_; /**< The pass drawing models, if there is one. */
+
+  };
+
+}
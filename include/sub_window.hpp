@@ -28,6 +28,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cinder/params/Params.h>
 
 #include <CinderOpenCV.h>
+#include <boost/cstdint.hpp>
+
+#include "frame_writer.hpp"
+#include "pixel_readback.hpp"
 
 namespace viz {
 
@@ -44,7 +48,7 @@ namespace viz {
     /**
     * Empty constructor.
     */
-    SubWindow() : can_save_(false), frame_count_(0), file_count_(0) { }
+    SubWindow() : can_save_(false), has_contents_(false), signature_(0) { }
 
     /**
     * Create a window with dimensions.
@@ -85,6 +89,14 @@ namespace viz {
     */
     void UnBind();
 
+    /**
+    * Check if the framebuffer needs drawing again, i.e. nothing has been drawn yet or something it shows has changed since it was last drawn. If not,
+    * the last contents can just be shown again.
+    * @param[in] signature A hash of everything the contents depend on.
+    * @return True if the framebuffer should be redrawn.
+    */
+    bool NeedsRedraw(const boost::uint64_t signature);
+
     /**
     * Query if the window is setup for saving its contents.
     * @return true if this window supports dumping content to file. false otherwise.
@@ -98,9 +110,11 @@ namespace viz {
     bool IsSaving() const;
 
     /**
-    * Write the current contents to file. Assumes the capture has been initialized with InitSavingWindow().
+    * Start reading back the current contents to write to file. The read finishes in the background and the frame is written a couple of frames later,
+    * or when the stream is closed. Assumes the capture has been initialized with InitSavingWindow().
+    * @param[in] wait Wait for the read and write the frame (and any earlier ones still in flight) now, for saving single frames.
     */
-    void WriteFrameToFile();
+    void WriteFrameToFile(const bool wait = false);
 
     /**
     * Draw a GUI window onto the internal texture.
@@ -121,13 +135,13 @@ namespace viz {
     void Draw();
 
     /**
-    * Initialise the window for saving. This process opens a file handle to an avi file using the OpenCV VideoWriter interface.
-    * @param[in] vid_file_idx An index to split the file up if it gets too large.
+    * Initialise the window for saving. If save_format is "png" this starts a numbered PNG sequence in a directory named after the window, otherwise
+    * it opens an avi file using the OpenCV VideoWriter interface. See OpenFrameWriter().
     */
-    void InitSavingWindow(const size_t vid_file_idx = 0);
+    void InitSavingWindow();
 
     /**
-    * Close the currently open video file (if applicable).
+    * Write any frames which are still being read back and close the currently open video file (if applicable).
     */
     void CloseStream();
 
@@ -156,22 +170,25 @@ namespace viz {
     size_t Height() const { return window_coords_.getHeight(); }
 
     static std::string output_directory; /**< The output directory where the subwindows all dump their content. */
+    static std::string save_format; /**< Either "avi" for uncompressed AVI chunks or "png" for a lossless PNG sequence. */
+    static int png_compression; /**< The zlib compression level (0-9) for PNG sequences. */
 
     cv::Mat getFrame() { return ci::toOcv(framebuffer_->getTexture()); }
 
     protected:
 
-    size_t frame_count_;
-    size_t file_count_;
-
     ci::Rectf window_coords_; /**< The window coordinates within the main window reference frame. */
     boost::shared_ptr<ci::gl::Fbo> framebuffer_; /**< The framebuffer of size width, height which is rendered to when we draw to this subwindow. */
     ci::gl::Texture texture_; /**< The texture that is attached to this framebuffer. */
 
     std::string name_; /**< The window name, must be unique. */
-    cv::VideoWriter writer_; /**< The video writer. */
+    boost::shared_ptr<FrameWriter> frame_writer_; /**< Writes the saved frames to a video file or PNG sequence, only set while saving. */
+    boost::shared_ptr<PixelReadback> readback_; /**< Reads the framebuffer back while saving. Only allocated when saving starts. */
+    cv::Mat readback_frame_; /**< Storage for the frames finished by readback_. */
 
     bool can_save_; /**< If the window is capable of saving its contents. */
+    bool has_contents_; /**< If anything has been drawn into the framebuffer yet. */
+    boost::uint64_t signature_; /**< The signature of the inputs the framebuffer was last drawn with. */
     ci::params::InterfaceGlRef save_params_; /**< Small UI element to switch on an off saving. */
 
   };
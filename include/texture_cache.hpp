@@ -0,0 +1,120 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Texture.h>
+#include <opencv2/core/core.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+namespace viz {
+
+  /**
+  * @struct MipChain
+  * @brief Every mip level of a texture, ready to upload without any decoding or resampling.
+  */
+  struct MipChain {
+
+    enum Format {
+      BGR8 = 0, /**< Uncompressed, 3 bytes per pixel. */
+      BGRA8 = 1, /**< Uncompressed, 4 bytes per pixel. */
+      DXT1 = 2 /**< S3TC block compressed, 8 bytes per 4x4 block and no alpha. */
+    };
+
+    /**
+    * A single mip level.
+    */
+    struct Level {
+      int width; /**< The level width in pixels. */
+      int height; /**< The level height in pixels. */
+      std::vector<unsigned char> data; /**< The pixels (rows from the top of the image) or the compressed blocks. */
+    };
+
+    /**
+    * Build the chain from a decoded image, halving it with an area filter down to 1x1.
+    * @param[in] image The full resolution image, 8 or 16 bit with 1, 3 or 4 channels.
+    * @param[in] compress Store the levels DXT1 compressed. Images with an alpha channel are never compressed.
+    */
+    void Build(const cv::Mat &image, const bool compress);
+
+    /**
+    * Upload the levels to a new OpenGL texture. Must be called from the thread with the OpenGL context.
+    * @return The texture, which owns the OpenGL texture.
+    */
+    ci::gl::Texture Upload() const;
+
+    Format format; /**< How the levels are stored. */
+    std::vector<Level> levels; /**< The levels, full resolution first. */
+
+  };
+
+  /**
+  * @class TextureCache
+  * @brief A preprocessed copy of a texture image holding its whole mip chain.
+  * Decoding a high resolution PNG and building its mipmaps is slow, so the mip chain is built once and cached next to the image (or in the temp
+  * directory if that can't be written to), like the MeshCache. The cache stores a hash of the image contents and is ignored if they change.
+  */
+  class TextureCache {
+
+  public:
+
+    /**
+    * Hash the image and work out where its cache can go.
+    * @param[in] image_file The path to the texture image.
+    * @param[in] compress Whether the cached chain is block compressed, compressed and uncompressed chains are cached separately.
+    */
+    TextureCache(const std::string &image_file, const bool compress);
+
+    /**
+    * Load the mip chain from the cache, or build it from the image and cache it if there isn't a valid cache.
+    * @param[out] chain The mip chain.
+    * @return False if the image couldn't be decoded.
+    */
+    bool Load(MipChain &chain) const;
+
+  protected:
+
+    /**
+    * Load the mip chain from one of the cache locations.
+    * @param[in] cache_path The cache file.
+    * @param[out] chain The cached chain.
+    * @return True if the file exists and is valid for the image.
+    */
+    bool LoadFrom(const std::string &cache_path, MipChain &chain) const;
+
+    /**
+    * Write the mip chain to one of the cache locations.
+    * @param[in] cache_path The cache file.
+    * @param[in] chain The chain to save.
+    * @return True if the whole file was written.
+    */
+    bool SaveTo(const std::string &cache_path, const MipChain &chain) const;
+
+    std::string image_file_; /**< The source image. */
+    bool compress_; /**< Whether the chain is block compressed. */
+    std::vector<std::string> cache_paths_; /**< The places the cache can be, in the order they are tried. */
+    boost::uint64_t source_hash_; /**< The FNV-1a hash of the image and the compression setting. */
+
+  };
+
+}
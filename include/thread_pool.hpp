@@ -0,0 +1,202 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <exception>
+
+namespace viz {
+
+  /**
+  * @class ThreadPool
+  * @brief A simple fixed size pool of worker threads.
+  * Jobs are run in the order they are submitted, although they can finish in any order. Use the futures returned by Submit() if the results need to be
+  * collected in order.
+  */
+  class ThreadPool {
+
+  public:
+
+    /**
+    * Start the worker threads.
+    * @param[in] num_threads The number of threads to start. If 0 then one thread per hardware core is started.
+    */
+    explicit ThreadPool(std::size_t num_threads = 0) : stop_(false) {
+
+      if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+      for (std::size_t i = 0; i < num_threads; ++i){
+        workers_.push_back(std::thread(std::bind(&ThreadPool::WorkerLoop, this)));
+      }
+
+    }
+
+    /**
+    * Finish all of the outstanding jobs and join the worker threads.
+    */
+    ~ThreadPool(){
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      condition_.notify_all();
+
+      for (std::size_t i = 0; i < workers_.size(); ++i){
+        workers_[i].join();
+      }
+
+    }
+
+    /**
+    * Queue a job to run on one of the worker threads.
+    * @param[in] job The job to run.
+    * @return A future which holds the result of the job (or the exception it threw).
+    */
+    template<typename Function>
+    std::future<typename std::result_of<Function()>::type> Submit(Function job){
+
+      typedef typename std::result_of<Function()>::type ResultType;
+      std::shared_ptr< std::packaged_task<ResultType()> > task(new std::packaged_task<ResultType()>(job));
+      std::future<ResultType> result = task->get_future();
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        jobs_.push_back([task](){ (*task)(); });
+      }
+      condition_.notify_one();
+
+      return result;
+
+    }
+
+    /**
+    * Split a range into chunks and run body on each chunk in parallel. Returns when all of the chunks are done, even if one of them throws, and then
+    * rethrows the first exception. One of the chunks is run on the calling thread. The chunks queue behind any jobs already submitted, so use a pool
+    * which isn't also running long background jobs, see Compute().
+    * @param[in] begin The start of the range.
+    * @param[in] end One past the end of the range.
+    * @param[in] body The function to run on each chunk, it is passed the start and one past the end of the chunk.
+    */
+    void ParallelFor(const std::size_t begin, const std::size_t end, const std::function<void(std::size_t, std::size_t)> &body){
+
+      if (end <= begin) return;
+
+      const std::size_t num_chunks = std::min(end - begin, workers_.size() + 1);
+      const std::size_t chunk_size = (end - begin + num_chunks - 1) / num_chunks;
+
+      std::vector< std::future<void> > chunks;
+      std::size_t chunk_start = begin;
+      for (; chunk_start + chunk_size < end; chunk_start += chunk_size){
+        const std::size_t chunk_end = chunk_start + chunk_size;
+        chunks.push_back(Submit([&body, chunk_start, chunk_end](){ body(chunk_start, chunk_end); }));
+      }
+
+      std::exception_ptr error;
+      try{
+        body(chunk_start, end);
+      }
+      catch (...){
+        error = std::current_exception();
+      }
+
+      //the other chunks refer to body, so they all have to finish before this returns or throws
+      for (std::size_t i = 0; i < chunks.size(); ++i){
+        try{
+          chunks[i].get();
+        }
+        catch (...){
+          if (!error) error = std::current_exception();
+        }
+      }
+
+      if (error) std::rethrow_exception(error);
+
+    }
+
+    /**
+    * Get the number of worker threads.
+    * @return The number of threads.
+    */
+    std::size_t Size() const { return workers_.size(); }
+
+    /**
+    * Get a process wide pool with one thread per core for background jobs, such as loading assets and compressing saved frames. Created the first
+    * time it's needed.
+    * @return The shared pool.
+    */
+    static ThreadPool &Shared(){
+      static ThreadPool pool;
+      return pool;
+    }
+
+    /**
+    * Get a process wide pool with one thread per core for ParallelFor(), separate from Shared() so a caller waiting on its chunks never waits behind
+    * queued background jobs. Created the first time it's needed.
+    * @return The compute pool.
+    */
+    static ThreadPool &Compute(){
+      static ThreadPool pool;
+      return pool;
+    }
+
+  protected:
+
+    /**
+    * Run jobs until the pool is stopped and there are no jobs left.
+    */
+    void WorkerLoop(){
+
+      while (true){
+
+        std::function<void()> job;
+
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          condition_.wait(lock, [this](){ return stop_ || !jobs_.empty(); });
+          if (stop_ && jobs_.empty()) return;
+          job = jobs_.front();
+          jobs_.pop_front();
+        }
+
+        job();
+
+      }
+
+    }
+
+    std::vector<std::thread> workers_; /**< The worker threads. */
+    std::deque< std::function<void()> > jobs_; /**< The jobs waiting to run. */
+    std::mutex mutex_; /**< Protects the job queue. */
+    std::condition_variable condition_; /**< Signalled when a job is added or the pool is stopped. */
+    bool stop_; /**< Set when the pool is being destroyed. */
+
+  };
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Vbo.h>
+#include <cinder/Matrix.h>
+#include <vector>
+
+namespace viz {
+
+  /**
+  * @class TrajectoryBuffer
+  * @brief Keeps the path of a trajectory in vertex buffers on the GPU, at several levels of detail.
+  * The buffers are append-only, each update just adds the poses since the last one, and a level is drawn as a single line strip, so the cost per
+  * frame doesn't grow with the length of the session. Every few hundred points the finished chunk of the path is simplified with Douglas-Peucker at
+  * each level's tolerance and appended to that level. When drawing, the coarsest level whose error is under a pixel on screen is used, with the
+  * unfinished chunk drawn at full detail. If the trajectory has been truncated (e.g. by a seek) it is built again.
+  */
+  class TrajectoryBuffer {
+
+  public:
+
+    /**
+    * Create an empty buffer. Nothing is allocated on the GPU until the first draw, so this doesn't need an OpenGL context.
+    */
+    TrajectoryBuffer();
+
+    /**
+    * Bring the buffer up to date with a trajectory.
+    * @param[in] transforms The poses of the trajectory, usually the same vector as the last update with some more poses on the end.
+    */
+    void Update(const std::vector<ci::Matrix44f> &transforms);
+
+    /**
+    * Draw the trajectory as a line strip through the positions of its poses, in the current color. The level of detail is picked using the current
+    * modelview, projection and viewport.
+    * @param[in] max_error_pixels The furthest the simplified path can be from the full one on screen.
+    */
+    void Draw(const float max_error_pixels = 1.0f);
+
+  protected:
+
+    /**
+    * @struct Level
+    * @brief The path simplified to one tolerance.
+    */
+    struct Level {
+
+      float tolerance; /**< The furthest any pose can be from the simplified path, in world units. 0 for the full path. */
+      std::vector<ci::Vec3f> points; /**< The simplified path. */
+      ci::gl::Vbo vbo; /**< The GPU copy of the path. */
+      std::size_t capacity; /**< The number of points vbo can hold. */
+      std::size_t num_uploaded; /**< The number of points copied into vbo so far. */
+
+    };
+
+    /**
+    * Throw away all of the levels.
+    */
+    void Clear();
+
+    /**
+    * Simplify the next finished chunk of the full path and append it to each of the coarser levels.
+    */
+    void SimplifyNextChunk();
+
+    /**
+    * Copy the points of a level which haven't been uploaded yet into its vertex buffer, reallocating it if it's full.
+    * @param[in,out] level The level to upload.
+    */
+    void Upload(Level &level);
+
+    /**
+    * Draw a run of points from a level as a line strip.
+    * @param[in] level The level, which must have been uploaded.
+    * @param[in] first The first point.
+    * @param[in] count The number of points.
+    */
+    void DrawStrip(Level &level, const std::size_t first, const std::size_t count);
+
+    std::vector<Level> levels_; /**< The levels of detail, from the full path to the coarsest. */
+    std::size_t num_chunks_; /**< The number of chunks of the full path which have been simplified. */
+    ci::Vec3f bounds_min_; /**< The minimum corner of the box around the path. */
+    ci::Vec3f bounds_max_; /**< The maximum corner of the box around the path. */
+
+  };
+
+}
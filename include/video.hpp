@@ -21,9 +21,67 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
 #include <opencv2/highgui/highgui.hpp>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <boost/shared_ptr.hpp>
+
+#include "frame_cache.hpp"
 
 namespace viz {
 
+  /**
+  * @class ProxyBuilder
+  * @brief Builds a reduced resolution copy of a video in a background thread.
+  * The proxy is an MJPG AVI (so every frame is a keyframe) with the same frames as the source, downscaled by a fixed factor. It is written to a
+  * temporary file and renamed when complete, so a proxy on disk is always a finished one. If an up to date proxy already exists it is reused.
+  */
+  class ProxyBuilder {
+
+  public:
+
+    /**
+    * Start building the proxy, or just mark it as ready if there is already an up to date one on disk.
+    * @param[in] inpath The path to the full resolution video.
+    * @param[in] scale The downscaling factor, 2 or 4.
+    */
+    ProxyBuilder(const std::string &inpath, const int scale);
+
+    /**
+    * Cancel the build if it's still running and wait for the thread to finish.
+    */
+    ~ProxyBuilder();
+
+    /**
+    * Check if the proxy has finished building.
+    * @return True if the proxy can be opened.
+    */
+    bool IsReady() const { return ready_; }
+
+    /**
+    * Get the path to the proxy file.
+    * @return The path.
+    */
+    const std::string &ProxyPath() const { return proxy_path_; }
+
+  protected:
+
+    /**
+    * Decode the source, downscale each frame and write it to the proxy. Runs on the background thread.
+    */
+    void Build();
+
+    std::string input_path_; /**< The full resolution video. */
+    std::string proxy_path_; /**< Where the proxy is cached. */
+    int scale_; /**< The downscaling factor. */
+
+    std::atomic<bool> ready_; /**< Set when the proxy is complete. */
+    std::atomic<bool> cancel_; /**< Set to stop the build early. */
+    std::thread thread_; /**< The background build thread. */
+
+  };
+
   /**
   * @class VideoIO
   * @brief Simple video input output wrapper.
@@ -36,7 +94,7 @@ namespace viz {
     /**
     * Set up a default object which basically does nothing. Only useful for delayed opening.
     */
-    VideoIO() : can_read_(false), is_open_(false) {}
+    VideoIO() : can_read_(false), is_open_(false), next_frame_(0), decoder_frame_(0), using_proxy_(false) {}
 
     /**
     * Open a input only version of the class - when we don't necessarily want to write anything.
@@ -87,6 +145,52 @@ namespace viz {
     */
     void CloseStreams();
 
+    /**
+    * Move the input so that the next call to Read() returns a specific frame. Jumps to the nearest keyframe at or before the target and decodes forward from there, 
+    * or just decodes forward from the current position if that is closer.
+    * @param[in] frame The index of the frame to seek to.
+    * @return True if the seek succeeded, false if the frame is past the end of the video.
+    */
+    bool Seek(const std::size_t frame);
+
+    /**
+    * Get the index of the frame that the next call to Read() will return.
+    * @return The frame index.
+    */
+    std::size_t NextFrameIndex() const { return next_frame_; }
+
+    /**
+    * Start building a reduced resolution proxy of the input video in the background. Does nothing for image inputs.
+    * @param[in] scale The downscaling factor, must be 2 or 4.
+    */
+    void GenerateProxy(const int scale);
+
+    /**
+    * Switch between decoding the proxy and the full resolution video. The next call to Read() returns the same frame index after the switch.
+    * @param[in] use_proxy True to decode the proxy, false for full resolution.
+    * @return True if the video is now decoding what was asked for. False if the proxy isn't ready yet.
+    */
+    bool UseProxy(const bool use_proxy);
+
+    /**
+    * Check if the proxy has finished building.
+    * @return True if UseProxy() can switch to it.
+    */
+    bool IsProxyReady() const { return proxy_builder_ && proxy_builder_->IsReady(); }
+
+    /**
+    * Check if we are currently decoding the proxy.
+    * @return True if we are, false if we are decoding the full resolution video.
+    */
+    bool IsUsingProxy() const { return using_proxy_; }
+
+    /**
+    * Cache decoded full resolution frames in a memory mapped file next to the input video so replaying them doesn't need to decode them again.
+    * Does nothing for image inputs.
+    * @param[in] budget_bytes The maximum size of the cache file's frame data.
+    */
+    void EnableFrameCache(const std::size_t budget_bytes);
+
 
     /**
     * Check if we can read from this file.
@@ -109,10 +213,63 @@ namespace viz {
     std::size_t image_width_; /**< The image width we are writing. */
     std::size_t image_height_; /**< The image height we are writing. */
 
+    /**
+    * Load the keyframe index for the input video from its cache file or build it (and write the cache) if the cache is missing or stale.
+    * @param[in] inpath The path to the input video file.
+    */
+    void LoadKeyframeIndex(const std::string &inpath);
+
+    /**
+    * Build the keyframe index by reading the idx1 chunk of an AVI file. 
+    * @param[in] inpath The path to the input video file.
+    * @return True if the file had a usable index, false otherwise.
+    */
+    bool BuildKeyframeIndexFromAvi(const std::string &inpath);
+
+    /**
+    * Find the last keyframe at or before a frame.
+    * @param[in] frame The target frame.
+    * @return The index of the keyframe.
+    */
+    std::size_t NearestKeyframe(const std::size_t frame) const;
+
+    /**
+    * Get the frame at next_frame_ from the frame cache, or decode it (moving the decoder there first if it's somewhere else) and add it to the cache.
+    * @param[out] frame The frame, empty if there are no more frames.
+    * @return True if a frame was read.
+    */
+    bool ReadFrame(cv::Mat &frame);
+
+    /**
+    * Move the decoder so the next frame it decodes is a specific frame.
+    * @param[in] frame The index of the frame.
+    * @return True if the seek succeeded, false if the frame is past the end of the video.
+    */
+    bool SeekDecoder(const std::size_t frame);
+
     bool can_read_; /**< Boolean for whether we can actually read this file. */
     bool is_open_; /**< Boolean for whether we have opened the file. */
 
+    std::size_t next_frame_; /**< The index of the frame the next Read() returns. */
+    std::size_t decoder_frame_; /**< The index of the frame cap_ decodes next. Lags next_frame_ when frames come from the frame cache. */
+    std::vector<std::size_t> keyframes_; /**< Sorted indexes of the keyframes in the video. Always contains frame 0. */
+
+    std::string input_path_; /**< The path to the full resolution input. */
+    boost::shared_ptr<ProxyBuilder> proxy_builder_; /**< Builds the reduced resolution proxy, if one was requested. */
+    bool using_proxy_; /**< Whether cap_ is reading the proxy rather than the full resolution input. */
+    boost::shared_ptr<FrameCache> frame_cache_; /**< Cache of decoded full resolution frames, if enabled. */
+
   };
 
+  /**
+  * Get a decoded frame ready for uploading to a texture of a given size. If the frame is already the right size this is a no-op and returns the frame itself,
+  * otherwise it is resized straight into the (persistent) resize buffer. Channel order is left as BGR as the swizzle is done by the texture upload.
+  * @param[in] frame The decoded frame.
+  * @param[in] target_size The size of the texture.
+  * @param[in,out] resize_buffer Storage for the resized frame. Reused between calls to avoid reallocating.
+  * @return The frame to upload.
+  */
+  const cv::Mat &PrepareFrameForUpload(const cv::Mat &frame, const cv::Size &target_size, cv::Mat &resize_buffer);
+
 
 }
\ No newline at end of file
@@ -29,9 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cinder/params/Params.h>
 #include <boost/tuple/tuple.hpp>
 
-#include "camera.hpp"
-#include "pose_grabber.hpp"
-#include "video.hpp"
+#include "session.hpp"
 #include "sub_window.hpp"
 
 using namespace ci;
@@ -39,22 +37,7 @@ using namespace ci::app;
 
 namespace viz {
 
-  /**
-  * @struct State
-  * @brief Simple container to represent the state of the application.
-  */
- 
-  struct State {
-
-    bool save_all; /**< Flag to save all frames and data. */
-    bool save_one; /**< Flag to save the next loaded frame and data. */
-
-    bool load_all; /**< Flag to load all frames and data without stopping. */
-    bool load_one; /**< Flag to save just the next frame and data. */
-
-  };
-
-  class vizApp : public AppNative {
+  class vizApp : public AppNative, public Session {
 
   public:
 
@@ -72,11 +55,17 @@ namespace viz {
     void editPoseButton(const size_t item_idx);
     void resetViewerButton();
     void savePoseButton();
+    void seekButton();
 
     static void AddSubWindow(SubWindow *sbw) { sub_windows_.push_back(sbw); }
 
   protected:
 
+    /**
+    * Append the image position of each trackable's head and the direction of its shaft in the left eye to a track file per trackable. The points are
+    * projected on the CPU from the current frame's poses, so this doesn't touch OpenGL. Called with the other outputs whenever a frame is saved, and
+    * the points are in the raw image if distort-overlays is set.
+    */
     void save2DTrack();
 
     SubWindow left_eye;
@@ -86,121 +75,57 @@ namespace viz {
     SubWindow scene_viewer;
     SubWindow trajectory_viewer;
 
-    State state;
-    
-    bool running_;
-
     void draw3DViewports();
     void drawCameraEyes();
     void drawLeftEye();
     void drawRightEye();
     void setupGUI();
-    void updateModels();
-    void updateVideo();
-
-    /**
-    * Create a visualization environment from a configuration file. To see an example configuration file, see config/app.cfg.
-    * @param[in] path The path to the config file.
-    */
-    void setupFromConfig(const std::string &path);
-    
-    /**
-    * Save the state of the current tracked object poses and any windows which are set to save their contents (useful if they have been modified within the GUI).
-    */
-    void saveState();
-    
-    /**
-    * Save a frame and the current tracked object poses (useful if they have been modified within the GUI).
-    */
-    void savePoses();
-
-    /**
-    * Draw a grid on the ground plane. 
-    * @param[in] size The size of the grid.
-    * @param[in] step The length of each grid square.
-    * @param[in] plane_position The vertical position of the plane.
-    */
-    void drawGrid(float size = 3.9, float step = 0.3, float plane_position = 0.0);
-
-    /**
-    * Call the draw method on all of the trackable targets.
-    */
-    void drawTargets();
 
     /**
-    * Draw the visualization for either the left or right eye. This corresponds to drawing the camera view and the positions of the instruments in front of the camera.
-    * @param[in] texture The background image (i.e. what the camera captured).
-    * @param[in] is_left Flag to set whether the camera is the left or right one.
-    */
-    void drawEye(gl::Texture &texture, bool is_left);
-    
-    /**
-    * Manually edit the pose of the targets in the GUI. This is useful for resolving offsets in the Da Vinci internal pose estimates.
-    * @param[in] event The key event which corresponds to an instruction to move the pose in a specific way.
+    * Draw the eye and 3D views into their sub windows' framebuffers and save them if saving is switched on.
     */
-    void movePose(KeyEvent event);
+    void renderViews();
 
     /**
-    * Draw the 3D scene with the camera and trackable targets from a observer viewpoint.
-    * @param[in] left_image The current left camera frame, is draw onto the camera model in the 3D viewer.
-    * @param[in] right_image The current right camera frame, is draw onto the camera model in the 3D viewer.
+    * Hash everything the eye views depend on: the camera frames, the camera pose and the poses of the trackables.
+    * @return The signature to compare against the one the eye views were last drawn with.
     */
-    void drawScene(gl::Texture &left_image, gl::Texture &right_image);
+    boost::uint64_t eyeSignature() const;
 
     /**
-    * Draw the camera view onto the viewport.
-    * @param[in] image The camera view.
-    */
-    void draw2D(gl::Texture &image);
-
-    /** 
-    * Draw a 3D model of a camera with it's view mapped onto it's image plane.
-    * @param[in] left_image The left image viewed by the camera.
-    * @param[in] right_image The right image viewed by the camera.
+    * Hash everything the 3D scene view depends on, which is the eye view inputs plus the scene's own camera and the camera poses.
+    * @return The signature to compare against the one the scene view was last drawn with.
     */
-    void drawCamera(gl::Texture &left_image, gl::Texture &right_image);
+    boost::uint64_t sceneSignature() const;
 
     /**
-    * Actually map the image onto the camera image plane.
-    * @param[in] image_data The image viewed by the camera.
-    * @param[in] tl The 3D coordinates of the top left corner of the camera view.
-    * @param[in] bl The 3D coordinates of the top bottom corner of the camera view.
-    * @param[in] tr The 3D coordinates of the top left right of the camera view.
-    * @param[in] br The 3D coordinates of the top bottom right of the camera view.
+    * Hash everything the camera trajectory view depends on.
+    * @return The signature to compare against the one the trajectory view was last drawn with.
     */
-    void drawImageOnCamera(gl::Texture &image_data, ci::Vec3f &tl, ci::Vec3f &bl, ci::Vec3f &tr, ci::Vec3f &br);
+    boost::uint64_t trajectorySignature() const;
 
     /**
-    * Draw the trajectory of the tracked object as a set of minimal representations of it's pose at each frame.
-    * @param[in] transforms The 6 DOF poses the object took at each frame.
-    * @param[in] color The color of the trajectory.
+    * Set the frame rate and vertical sync for the current processing mode. When uncapped the app only wakes up at the preview rate and vsync is
+    * switched off so update() can process as many frames as it can in between.
     */
-    void drawTrajectories(const std::vector<ci::Matrix44f> &transforms, ci::Color &color);
+    void applyFrameRateMode();
 
     /**
-    * Draw the trajectories of a tracked camera and the ground truth.
+    * Load a session from a configuration file and point the saving windows at its output directory.
+    * @param[in] path The path to the config file.
     */
-    void drawCameraTracker();
+    void setupFromConfig(const std::string &path);
     
     /**
-    * Load one of the trackables.
-    * @param[in] reader The ConfigReader which has the location of the config file for this trackable.
-    * @param[in] output_dir_this_run Create a new output directory for the trackables.
-    */
-    void loadTrackables(const ConfigReader &reader, const std::string &output_dir_this_run);
-
-    /**
-    * Wrapper to get the current camera pose. If we have loaded a moveable camera then return its pose, if not then return the identity transform.
-    * @return The current camera pose as a 4x4 matrix.
+    * Save the state of the current tracked object poses and any windows which are set to save their contents (useful if they have been modified within the GUI).
     */
-    ci::Matrix44f getCameraPose();
+    void saveState();
 
     /**
-    * Load a single trackable. Called by loadTrackables().
-    * @param[in] filepath The path to the config file for this trackable.
-    * @param[in] output_dir The directory where any output for this trackable should be saved.
+    * Manually edit the pose of the targets in the GUI. This is useful for resolving offsets in the Da Vinci internal pose estimates.
+    * @param[in] event The key event which corresponds to an instruction to move the pose in a specific way.
     */
-    void loadTrackable(const std::string &filepath, const std::string &ouput_dir);
+    void movePose(KeyEvent event);
 
     /**
     * Apply a manual offset to a DH parameter camera pose.
@@ -214,40 +139,18 @@ namespace viz {
     */
     void applyOffsetToTrackedObject(KeyEvent &event, const int current_model_idx);
 
-    VideoIO video_left_; /**< The left video IO device. Reads input frames and saves the frames with the corresponding output save on top. */
-    VideoIO video_right_;  /**< The right video IO device. Reads input frames and saves the frames with the corresponding output save on top. */
-    VideoIO stereo_video_;
-
-    StereoCamera camera_; /**< The physical camera device which models the actual camera which views the scene. Handles projection the models into the image plane of the camera with physically realistic results. */
-
-    gl::Texture left_texture_; /**< The current left camera view */
-    gl::Texture right_texture_; /**< The current right camera view */
-    gl::Fbo framebuffer_; /**< The framebuffer to hold the drawing for the 'eye' views. */
-    gl::Fbo framebuffer_3d_; /**< The framebuffer to the hold the drawing for the 3D view. */
-
-    MayaCamUI maya_cam_2_;
-    MayaCamUI maya_cam_; /**< The framebuffer to the hold the drawing for the 3D view. */
     ci::Vec2i	mouse_pos_; /**< Current estimate of mouse position. */
 
-    std::vector< boost::shared_ptr<BasePoseGrabber> > trackables_; /**< The set of trackable objects to draw on the views. */
-    boost::shared_ptr<BasePoseGrabber> moveable_camera_; /**< A possibly movable camera too. If this isn't set then the identity camera transform is used (leaving the camera always at the origin). */
-    boost::shared_ptr<BasePoseGrabber> tracked_camera_; /**< If we are tracking the possibly moveable camera then we can visualize how the tracking performance was with this object. */
-    
-    gl::GlslProg shader_; /**< Shader to draw the models more nicely than with the fixed-pipeline drawing. */
-
-    size_t camera_image_width_; /**< The image width we are loading from the camera. */
-    size_t camera_image_height_; /**< The image height we are loading from the camera. */
-    size_t three_dim_viz_width_; /**< The width of the 3D visualizer window. */
-    size_t three_dim_viz_height_; /**< The width of the 3D visualizer window. */
-
     ci::params::InterfaceGlRef	gui_; /**< The GUI. */
 
     static std::vector<SubWindow *> sub_windows_; /**< A set of pointers to the various SubWindows in the display. Allows easy iteration over these windows for saving etc. */
 
-    bool reset_viz_port_; /**< Flag to reset the vizport if we move the MayaCam too far away. */
+    int seek_frame_; /**< The frame to seek to when the seek button is pressed. */
 
-    gl::Fbo shaft_framebuffer;
-    gl::Fbo head_framebuffer;
+    bool uncapped_; /**< Process frames as fast as possible while running rather than one per displayed frame. */
+    bool uncapped_applied_; /**< The mode the frame rate was last set up for, to spot when the GUI toggle changes. */
+    float preview_rate_; /**< How often the display is refreshed (in Hz) while processing uncapped. */
+    bool views_rendered_; /**< Set when update() has already rendered the views for this display frame. */
 
   };
 
@@ -0,0 +1,227 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/asset_cache.hpp"
+#include "../include/mesh_cache.hpp"
+#include "../include/mesh_decimation.hpp"
+#include "../include/texture_cache.hpp"
+#include "../include/thread_pool.hpp"
+#include <cinder/ObjLoader.h>
+#include <cinder/ImageIo.h>
+#include <boost/filesystem.hpp>
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+
+using namespace viz;
+
+namespace {
+
+  const std::size_t NUM_LEVELS_OF_DETAIL = 3;
+  const std::size_t LEVEL_OF_DETAIL_REDUCTION = 4; /**< Each level has this many times fewer triangles than the one before. */
+  const std::size_t MIN_LEVEL_OF_DETAIL_TRIANGLES = 64; /**< Don't bother decimating below this many triangles. */
+
+  ci::Sphere BoundingSphere(const ci::TriMesh &mesh){
+
+    const std::vector<ci::Vec3f> &vertices = mesh.getVertices();
+    if (vertices.empty()) return ci::Sphere(ci::Vec3f::zero(), 0);
+
+    ci::Vec3f min_corner = vertices[0], max_corner = vertices[0];
+    for (std::size_t i = 1; i < vertices.size(); ++i){
+      min_corner.x = std::min(min_corner.x, vertices[i].x); max_corner.x = std::max(max_corner.x, vertices[i].x);
+      min_corner.y = std::min(min_corner.y, vertices[i].y); max_corner.y = std::max(max_corner.y, vertices[i].y);
+      min_corner.z = std::min(min_corner.z, vertices[i].z); max_corner.z = std::max(max_corner.z, vertices[i].z);
+    }
+
+    return ci::Sphere((min_corner + max_corner) * 0.5f, 0.5f * min_corner.distance(max_corner));
+
+  }
+
+  /**
+  * Build the levels of detail for a mesh, or load them from their caches. Each level is decimated from the one before, so its error is the sum of the
+  * errors of the decimations so far.
+  */
+  void DecodeLevelsOfDetail(const std::string &obj_file, const std::string &mtl_file, AssetCache::Mesh &mesh){
+
+    const ci::TriMesh *previous = &mesh.mesh;
+    float previous_error = 0;
+
+    for (std::size_t level = 1; level <= NUM_LEVELS_OF_DETAIL; ++level){
+
+      const std::size_t target_triangles = previous->getNumTriangles() / LEVEL_OF_DETAIL_REDUCTION;
+      if (target_triangles < MIN_LEVEL_OF_DETAIL_TRIANGLES) return;
+
+      std::stringstream variant;
+      variant << ".lod" << level;
+      MeshCache cache(obj_file, mtl_file, true, variant.str());
+
+      boost::shared_ptr<AssetCache::Mesh> lod(new AssetCache::Mesh);
+      if (!cache.Load(lod->mesh, lod->error)){
+        lod->error = previous_error + DecimateMesh(*previous, target_triangles, lod->mesh);
+        cache.Save(lod->mesh, lod->error);
+      }
+
+      //stop if the decimation got stuck, another level wouldn't be any cheaper to draw
+      if (lod->mesh.getNumTriangles() >= previous->getNumTriangles()) return;
+
+      lod->bounds = mesh.bounds;
+      mesh.levels_of_detail.push_back(lod);
+      previous = &lod->mesh;
+      previous_error = lod->error;
+
+    }
+
+  }
+
+  /**
+  * Load a mesh from its binary cache, or parse the OBJ file (and cache it) if there isn't one. This doesn't touch OpenGL so it can run on any thread.
+  * @param[in] obj_file The OBJ file.
+  * @param[in] mtl_file The material file.
+  * @return The mesh, without its vertex buffer.
+  */
+  boost::shared_ptr<AssetCache::Mesh> DecodeMesh(const std::string &obj_file, const std::string &mtl_file){
+
+    boost::shared_ptr<AssetCache::Mesh> mesh(new AssetCache::Mesh);
+
+    //the components always have a texture so the texture coordinates are always loaded
+    MeshCache cache(obj_file, mtl_file, true);
+    if (!cache.Load(mesh->mesh)){
+      ci::ObjLoader loader(ci::loadFile(obj_file), ci::loadFile(mtl_file));
+      loader.load(&mesh->mesh, true, true, true);
+      cache.Save(mesh->mesh);
+    }
+
+    mesh->bounds = BoundingSphere(mesh->mesh);
+    DecodeLevelsOfDetail(obj_file, mtl_file, *mesh);
+
+    return mesh;
+
+  }
+
+  /**
+  * Load a texture's mip chain from its cache, or build it from the image (and cache it) if there isn't one. This doesn't touch OpenGL so it can run
+  * on any thread.
+  * @param[in] texture_file The image file.
+  * @param[in] compress Build a block compressed chain.
+  * @return The mip chain, which has no levels if the image couldn't be decoded.
+  */
+  boost::shared_ptr<MipChain> DecodeTexture(const std::string &texture_file, const bool compress){
+
+    boost::shared_ptr<MipChain> chain(new MipChain);
+    if (!TextureCache(texture_file, compress).Load(*chain)) chain->levels.clear();
+    return chain;
+
+  }
+
+}
+
+bool AssetCache::compress_textures_ = false;
+bool AssetCache::headless_ = false;
+
+AssetCache &AssetCache::Shared(){
+  static AssetCache cache;
+  return cache;
+}
+
+std::string AssetCache::FileKey(const std::string &path){
+
+  boost::system::error_code ec;
+  const boost::filesystem::path canonical = boost::filesystem::canonical(path, ec);
+  return ec ? path : canonical.string();
+
+}
+
+void AssetCache::Load(const std::vector<Request> &requests){
+
+  ThreadPool &pool = ThreadPool::Shared();
+
+  std::map<std::string, std::future< boost::shared_ptr<Mesh> > > mesh_jobs;
+  std::map<std::string, std::pair<std::string, std::future< boost::shared_ptr<MipChain> > > > texture_jobs;
+
+  //only block compress if the driver can decompress it
+  const bool compress = compress_textures_ && !headless_ && ci::gl::isExtensionAvailable("GL_EXT_texture_compression_s3tc");
+
+  for (std::size_t i = 0; i < requests.size(); ++i){
+
+    const std::string mesh_key = MeshKey(requests[i]);
+    if (meshes_.count(mesh_key) == 0 && mesh_jobs.count(mesh_key) == 0){
+      const std::string obj_file = requests[i].obj_file, mtl_file = requests[i].mtl_file;
+      mesh_jobs[mesh_key] = pool.Submit([obj_file, mtl_file](){ return DecodeMesh(obj_file, mtl_file); });
+    }
+
+    const std::string texture_key = FileKey(requests[i].texture_file);
+    if (!headless_ && textures_.count(texture_key) == 0 && texture_jobs.count(texture_key) == 0){
+      const std::string texture_file = requests[i].texture_file;
+      texture_jobs[texture_key] = std::make_pair(texture_file, pool.Submit([texture_file, compress](){ return DecodeTexture(texture_file, compress); }));
+    }
+
+  }
+
+  //the uploads need the GL context so they happen here as each decode finishes
+  for (auto &job : mesh_jobs){
+    boost::shared_ptr<Mesh> mesh = job.second.get();
+    meshes_[job.first] = mesh;
+    if (headless_) continue;
+    mesh->vbo = ci::gl::VboMesh(mesh->mesh);
+    for (std::size_t i = 0; i < mesh->levels_of_detail.size(); ++i){
+      mesh->levels_of_detail[i]->vbo = ci::gl::VboMesh(mesh->levels_of_detail[i]->mesh);
+    }
+  }
+
+  ci::gl::Texture::Format format;
+  format.enableMipmapping(true);
+
+  for (auto &job : texture_jobs){
+    boost::shared_ptr<MipChain> chain = job.second.second.get();
+    if (chain->levels.empty()){
+      //not a format OpenCV can read, so let cinder have a go
+      textures_[job.first] = ci::gl::Texture(ci::loadImage(job.second.first), format);
+    }
+    else{
+      textures_[job.first] = chain->Upload();
+    }
+  }
+
+}
+
+boost::shared_ptr<const AssetCache::Mesh> AssetCache::GetMesh(const Request &request) const {
+
+  std::map<std::string, boost::shared_ptr<Mesh> >::const_iterator it = meshes_.find(MeshKey(request));
+  if (it == meshes_.end()) throw std::runtime_error("Error, mesh has not been loaded: " + request.obj_file);
+  return it->second;
+
+}
+
+ci::gl::Texture AssetCache::GetTexture(const Request &request) const {
+
+  if (headless_) return ci::gl::Texture();
+
+  std::map<std::string, ci::gl::Texture>::const_iterator it = textures_.find(FileKey(request.texture_file));
+  if (it == textures_.end()) throw std::runtime_error("Error, texture has not been loaded: " + request.texture_file);
+  return it->second;
+
+}
+
+ci::gl::VboMesh AssetCache::GetDerivedMesh(const std::string &key) const {
+
+  std::map<std::string, ci::gl::VboMesh>::const_iterator it = derived_meshes_.find(key);
+  return it == derived_meshes_.end() ? ci::gl::VboMesh() : it->second;
+
+}
@@ -0,0 +1,68 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <iostream>
+
+#include "../include/offscreen_context.hpp"
+#include "../include/batch_renderer.hpp"
+
+#ifndef VIZ_RESOURCE_DIR
+#define VIZ_RESOURCE_DIR "../resources"
+#endif
+
+int main(int argc, char **argv){
+
+  const int first_config = 1;
+
+  if (argc <= first_config){
+    std::cerr << "Usage: viz-batch /path/to/config.cfg [/path/to/another/config.cfg ...]\n";
+    return 1;
+  }
+
+  int num_failed = 0;
+
+  try{
+
+    viz::OffscreenContext context(1, 1);
+
+    //each session is independent so one bad config doesn't stop the rest
+    for (int i = first_config; i < argc; ++i){
+
+      try{
+        viz::BatchRenderer renderer(VIZ_RESOURCE_DIR);
+        const size_t frame_count = renderer.Run(argv[i]);
+        std::cout << "Rendered " << frame_count << " frames from " << argv[i] << std::endl;
+      }
+      catch (std::exception &e){
+        std::cerr << "Error rendering " << argv[i] << ": " << e.what() << std::endl;
+        num_failed++;
+      }
+
+    }
+
+  }
+  catch (std::exception &e){
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return num_failed == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,244 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <cinder/DataSource.h>
+
+#include "../include/batch_renderer.hpp"
+
+using namespace viz;
+using namespace ci;
+
+namespace {
+
+  /**
+  * Copy the entries added to a trajectory since the last call. A batch run never seeks, so the trajectories only grow.
+  * @param[in] history The trajectory.
+  * @param[in,out] sent The number of entries already copied.
+  * @param[out] entries The new entries.
+  */
+  void takeNewEntries(const std::vector<ci::Matrix44f> &history, size_t &sent, std::vector<ci::Matrix44f> &entries){
+
+    sent = std::min(sent, history.size());
+    entries.assign(history.begin() + sent, history.end());
+    sent = history.size();
+
+  }
+
+}
+
+BatchRenderer::BatchRenderer(const std::string &resource_dir){
+
+  shader_ = gl::GlslProg(loadFile(resource_dir + "/phong_vert.glsl"), loadFile(resource_dir + "/phong_frag.glsl"));
+
+}
+
+size_t BatchRenderer::Run(const std::string &config_path){
+
+  setupFromConfig(config_path);
+
+  if (!running_) throw std::runtime_error("Error, could not load a session from " + config_path);
+
+  framebuffer_3d_ = gl::Fbo(three_dim_viz_width_, three_dim_viz_height_);
+  gl::Fbo left_framebuffer(camera_image_width_, camera_image_height_);
+  gl::Fbo right_framebuffer(camera_image_width_, camera_image_height_);
+  gl::Fbo trajectory_framebuffer(three_dim_viz_width_, three_dim_viz_height_);
+
+  PixelReadback left_readback(left_framebuffer.getWidth(), left_framebuffer.getHeight());
+  PixelReadback right_readback(right_framebuffer.getWidth(), right_framebuffer.getHeight());
+  PixelReadback scene_readback(framebuffer_3d_.getWidth(), framebuffer_3d_.getHeight());
+  PixelReadback trajectory_readback(trajectory_framebuffer.getWidth(), trajectory_framebuffer.getHeight());
+
+  //same names and save-format as the windows in the interactive app so the outputs look the same. the readbacks flip the frames.
+  boost::shared_ptr<FrameWriter> left_writer = OpenFrameWriter(save_format_, output_directory_, "Left_Eye", cv::Size(left_framebuffer.getWidth(), left_framebuffer.getHeight()), png_compression_);
+  boost::shared_ptr<FrameWriter> right_writer = OpenFrameWriter(save_format_, output_directory_, "Right_Eye", cv::Size(right_framebuffer.getWidth(), right_framebuffer.getHeight()), png_compression_);
+  boost::shared_ptr<FrameWriter> scene_writer = OpenFrameWriter(save_format_, output_directory_, "3D_Viz", cv::Size(framebuffer_3d_.getWidth(), framebuffer_3d_.getHeight()), png_compression_);
+  boost::shared_ptr<FrameWriter> trajectory_writer = OpenFrameWriter(save_format_, output_directory_, "Trajectory_Viz", cv::Size(trajectory_framebuffer.getWidth(), trajectory_framebuffer.getHeight()), png_compression_);
+
+  //saving also keeps the videos at full resolution
+  state.load_all = true;
+  state.save_all = true;
+  updateProxy();
+
+  //a couple of frames between each stage is enough to smooth out the differences in time each one takes per frame
+  const size_t queue_size = 2;
+  BoundedQueue<PipelineFrame> decoded_frames(queue_size);
+  BoundedQueue<PipelineFrame> posed_frames(queue_size);
+
+  std::exception_ptr decode_error, pose_error, render_error;
+
+  std::thread decode_thread([&](){
+    try{
+      decodeFrames(decoded_frames);
+    }
+    catch (...){
+      decode_error = std::current_exception();
+    }
+    decoded_frames.Close();
+  });
+
+  std::thread pose_thread([&](){
+    try{
+      loadFramePoses(decoded_frames, posed_frames);
+    }
+    catch (...){
+      pose_error = std::current_exception();
+    }
+    //if the poses ran out first this also stops the decoder
+    decoded_frames.Close();
+    posed_frames.Close();
+  });
+
+  size_t frame_count = 0;
+
+  try{
+
+    PipelineFrame frame;
+
+    while (posed_frames.Pop(frame)){
+
+      left_upload_.Upload(frame.left, left_texture_);
+      right_upload_.Upload(frame.right, right_texture_);
+      frame_generation_++;
+      receivePoses(frame.poses);
+
+      if (useSinglePassStereo()){
+        drawEyesSinglePass();
+        renderView(left_framebuffer, left_readback, *left_writer, [this](){ drawEyeFromStereo(true); });
+        renderView(right_framebuffer, right_readback, *right_writer, [this](){ drawEyeFromStereo(false); });
+      }
+      else{
+        renderView(left_framebuffer, left_readback, *left_writer, [this](){ drawEye(left_texture_, true); });
+        renderView(right_framebuffer, right_readback, *right_writer, [this](){ drawEye(right_texture_, false); });
+      }
+      renderView(framebuffer_3d_, scene_readback, *scene_writer, [this](){ drawScene(left_texture_, right_texture_); });
+      renderView(trajectory_framebuffer, trajectory_readback, *trajectory_writer, [this](){ drawCameraTracker(); });
+
+      frame_count++;
+
+    }
+
+    finishView(left_readback, *left_writer);
+    finishView(right_readback, *right_writer);
+    finishView(scene_readback, *scene_writer);
+    finishView(trajectory_readback, *trajectory_writer);
+
+  }
+  catch (...){
+    render_error = std::current_exception();
+  }
+
+  //unblock the other stages if rendering stopped early
+  posed_frames.Close();
+  decoded_frames.Close();
+  decode_thread.join();
+  pose_thread.join();
+
+  running_ = false;
+
+  if (render_error) std::rethrow_exception(render_error);
+  if (pose_error) std::rethrow_exception(pose_error);
+  if (decode_error) std::rethrow_exception(decode_error);
+
+  return frame_count;
+
+}
+
+void BatchRenderer::decodeFrames(BoundedQueue<PipelineFrame> &output){
+
+  while (true){
+
+    cv::Mat left_frame, right_frame;
+    if (!readFrames(left_frame, right_frame)) return;
+
+    //new buffers for each frame as the previous frames are still queued
+    cv::Mat left_resize_buffer, left_undistort_buffer, right_resize_buffer, right_undistort_buffer;
+
+    PipelineFrame frame;
+    frame.left = prepareFrame(left_frame, camera_.GetLeftCamera(), left_resize_buffer, left_undistort_buffer);
+    frame.right = prepareFrame(right_frame, camera_.GetRightCamera(), right_resize_buffer, right_undistort_buffer);
+
+    //the decoder reuses its frame buffer, so if the frame didn't need preparing it has to be copied
+    if (frame.left.data == left_frame.data) frame.left = left_frame.clone();
+    if (frame.right.data == right_frame.data) frame.right = right_frame.clone();
+
+    if (!output.Push(std::move(frame))) return;
+
+  }
+
+}
+
+void BatchRenderer::loadFramePoses(BoundedQueue<PipelineFrame> &input, BoundedQueue<PipelineFrame> &output){
+
+  PipelineFrame frame;
+  size_t moveable_camera_sent = 0, tracked_camera_sent = 0;
+
+  while (input.Pop(frame)){
+
+    if (!loadPoses(true)) return;
+
+    //the poses are saved as they're loaded, which keeps them in frame order
+    savePoses();
+
+    capturePoses(frame.poses, false);
+    if (moveable_camera_) takeNewEntries(moveable_camera_->History(), moveable_camera_sent, frame.poses.moveable_camera_history);
+    if (tracked_camera_) takeNewEntries(tracked_camera_->History(), tracked_camera_sent, frame.poses.tracked_camera_history);
+
+    if (!output.Push(std::move(frame))) return;
+
+  }
+
+}
+
+void BatchRenderer::receivePoses(FramePoses &poses){
+
+  frame_poses_.camera_pose = poses.camera_pose;
+  frame_poses_.moveable_camera_pose = poses.moveable_camera_pose;
+  frame_poses_.tracked_camera_pose = poses.tracked_camera_pose;
+  frame_poses_.trackable_poses.swap(poses.trackable_poses);
+  frame_poses_.trackable_transforms.swap(poses.trackable_transforms);
+
+  frame_poses_.moveable_camera_history.insert(frame_poses_.moveable_camera_history.end(), poses.moveable_camera_history.begin(), poses.moveable_camera_history.end());
+  frame_poses_.tracked_camera_history.insert(frame_poses_.tracked_camera_history.end(), poses.tracked_camera_history.begin(), poses.tracked_camera_history.end());
+
+}
+
+void BatchRenderer::renderView(gl::Fbo &framebuffer, PixelReadback &readback, FrameWriter &writer, const std::function<void()> &draw_view){
+
+  framebuffer.bindFramebuffer();
+  gl::clear(Color(0, 0, 0));
+  draw_view();
+  framebuffer.unbindFramebuffer();
+
+  if (readback.Read(framebuffer, readback_frame_)){
+    writer.Write(readback_frame_);
+  }
+
+}
+
+void BatchRenderer::finishView(PixelReadback &readback, FrameWriter &writer){
+
+  while (readback.Finish(readback_frame_)){
+    writer.Write(readback_frame_);
+  }
+
+}
@@ -19,12 +19,184 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **/
 
 #include "../include/camera.hpp"
+#include "../include/thread_pool.hpp"
 #include <cinder/gl/gl.h>
 #include <cinder/app/App.h>
+#include <boost/filesystem.hpp>
+#include <boost/cstdint.hpp>
+#include <fstream>
+#include <algorithm>
 
 
 using namespace viz;
 
+namespace {
+
+  const char UNDISTORT_MAP_MAGIC[4] = { 'V', 'U', 'D', 'M' };
+  const boost::uint32_t UNDISTORT_MAP_VERSION = 1;
+
+  const char DISTORT_MAP_MAGIC[4] = { 'V', 'D', 'S', 'M' };
+  const boost::uint32_t DISTORT_MAP_VERSION = 1;
+
+  /**
+  * Read the calibration a cached map was built for and check it matches the current one.
+  * @param[in] ifs The open cache file, positioned after the magic and version.
+  * @param[in] camera_matrix The current OpenCV camera matrix.
+  * @param[in] distortion The current distortion parameters as a CV_64F row.
+  * @param[in] image_size The current image size.
+  * @return True if the cache was built for this calibration.
+  */
+  bool CalibrationMatches(std::ifstream &ifs, const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Size &image_size){
+
+    boost::int32_t width, height;
+    boost::uint32_t num_distortion;
+    ifs.read((char *)&width, sizeof(width));
+    ifs.read((char *)&height, sizeof(height));
+    ifs.read((char *)&num_distortion, sizeof(num_distortion));
+    if (!ifs || width != image_size.width || height != image_size.height || num_distortion != distortion.total()) return false;
+
+    for (int r = 0; r < 3; ++r){
+      for (int c = 0; c < 3; ++c){
+        double v;
+        ifs.read((char *)&v, sizeof(v));
+        if (!ifs || v != camera_matrix.at<double>(r, c)) return false;
+      }
+    }
+
+    for (size_t i = 0; i < num_distortion; ++i){
+      double v;
+      ifs.read((char *)&v, sizeof(v));
+      if (!ifs || v != distortion.at<double>(0, (int)i)) return false;
+    }
+
+    return true;
+
+  }
+
+  /**
+  * Load undistortion maps from a cache file if it was built for the current calibration.
+  * @return True if the maps were loaded.
+  */
+  bool LoadUndistortionMaps(const std::string &cache_file, const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Size &image_size, cv::Mat &map_xy, cv::Mat &map_interp){
+
+    std::ifstream ifs(cache_file.c_str(), std::ios::binary);
+    if (!ifs.is_open()) return false;
+
+    char magic[4];
+    boost::uint32_t version;
+    ifs.read(magic, sizeof(magic));
+    ifs.read((char *)&version, sizeof(version));
+    if (!ifs || !std::equal(magic, magic + 4, UNDISTORT_MAP_MAGIC) || version != UNDISTORT_MAP_VERSION) return false;
+
+    if (!CalibrationMatches(ifs, camera_matrix, distortion, image_size)) return false;
+
+    map_xy.create(image_size, CV_16SC2);
+    map_interp.create(image_size, CV_16UC1);
+    ifs.read((char *)map_xy.data, map_xy.total() * map_xy.elemSize());
+    ifs.read((char *)map_interp.data, map_interp.total() * map_interp.elemSize());
+
+    if (!ifs){
+      map_xy.release();
+      map_interp.release();
+      return false;
+    }
+
+    return true;
+
+  }
+
+  /**
+  * Write the calibration a cached map is built for, after the magic and version. Read back by CalibrationMatches().
+  */
+  void WriteCalibration(std::ofstream &ofs, const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Size &image_size){
+
+    const boost::int32_t width = image_size.width, height = image_size.height;
+    const boost::uint32_t num_distortion = (boost::uint32_t)distortion.total();
+    ofs.write((const char *)&width, sizeof(width));
+    ofs.write((const char *)&height, sizeof(height));
+    ofs.write((const char *)&num_distortion, sizeof(num_distortion));
+
+    for (int r = 0; r < 3; ++r){
+      for (int c = 0; c < 3; ++c){
+        ofs.write((const char *)&camera_matrix.at<double>(r, c), sizeof(double));
+      }
+    }
+    for (size_t i = 0; i < num_distortion; ++i){
+      ofs.write((const char *)&distortion.at<double>(0, (int)i), sizeof(double));
+    }
+
+  }
+
+  /**
+  * Save undistortion maps and the calibration they were built for to a cache file.
+  */
+  void SaveUndistortionMaps(const std::string &cache_file, const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Mat &map_xy, const cv::Mat &map_interp){
+
+    std::ofstream ofs(cache_file.c_str(), std::ios::binary);
+    if (!ofs.is_open()){
+      std::cerr << "Warning, could not write undistortion map cache: " << cache_file << "\n";
+      return;
+    }
+
+    ofs.write(UNDISTORT_MAP_MAGIC, sizeof(UNDISTORT_MAP_MAGIC));
+    ofs.write((const char *)&UNDISTORT_MAP_VERSION, sizeof(UNDISTORT_MAP_VERSION));
+    WriteCalibration(ofs, camera_matrix, distortion, map_xy.size());
+
+    //maps come straight from initUndistortRectifyMap so they're continuous
+    ofs.write((const char *)map_xy.data, map_xy.total() * map_xy.elemSize());
+    ofs.write((const char *)map_interp.data, map_interp.total() * map_interp.elemSize());
+
+  }
+
+  /**
+  * Load a distortion map from a cache file if it was built for the current calibration.
+  * @return True if the map was loaded.
+  */
+  bool LoadDistortionMap(const std::string &cache_file, const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Size &image_size, cv::Mat &map){
+
+    std::ifstream ifs(cache_file.c_str(), std::ios::binary);
+    if (!ifs.is_open()) return false;
+
+    char magic[4];
+    boost::uint32_t version;
+    ifs.read(magic, sizeof(magic));
+    ifs.read((char *)&version, sizeof(version));
+    if (!ifs || !std::equal(magic, magic + 4, DISTORT_MAP_MAGIC) || version != DISTORT_MAP_VERSION) return false;
+
+    if (!CalibrationMatches(ifs, camera_matrix, distortion, image_size)) return false;
+
+    map.create(image_size, CV_32FC2);
+    ifs.read((char *)map.data, map.total() * map.elemSize());
+
+    if (!ifs){
+      map.release();
+      return false;
+    }
+
+    return true;
+
+  }
+
+  /**
+  * Save a distortion map and the calibration it was built for to a cache file.
+  */
+  void SaveDistortionMap(const std::string &cache_file, const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Mat &map){
+
+    std::ofstream ofs(cache_file.c_str(), std::ios::binary);
+    if (!ofs.is_open()){
+      std::cerr << "Warning, could not write distortion map cache: " << cache_file << "\n";
+      return;
+    }
+
+    ofs.write(DISTORT_MAP_MAGIC, sizeof(DISTORT_MAP_MAGIC));
+    ofs.write((const char *)&DISTORT_MAP_VERSION, sizeof(DISTORT_MAP_VERSION));
+    WriteCalibration(ofs, camera_matrix, distortion, map.size());
+    ofs.write((const char *)map.data, map.total() * map.elemSize());
+
+  }
+
+}
+
 void Camera::Setup(const cv::Mat camera_matrix, const cv::Mat distortion_params, const int image_width, const int image_height, const int near_clip_distance, const int far_clip_distance){
 
   image_width_ = image_width;
@@ -36,6 +208,12 @@ void Camera::Setup(const cv::Mat camera_matrix, const cv::Mat distortion_params,
   camera_matrix_ = camera_matrix.clone();
   distortion_params_ = distortion_params.clone();
 
+  cv::Mat distortion;
+  distortion_params_.reshape(1, 1).convertTo(distortion, CV_64F);
+  for (int i = 0; i < 8; ++i){
+    distortion_coefficients_[i] = i < distortion.cols ? distortion.at<double>(0, i) : 0.0;
+  }
+
   //setup openGL projection matrix
   gl_projection_matrix_.setToNull();
   gl_projection_matrix_.m00 = (float)camera_matrix_.at<double>(0, 0);
@@ -50,6 +228,130 @@ void Camera::Setup(const cv::Mat camera_matrix, const cv::Mat distortion_params,
 
 }
 
+cv::Mat Camera::GetOpenCVCameraMatrix() const {
+
+  //undo the principal point flip from StereoCamera::convertBouguetToGLCoordinates
+  cv::Mat camera_matrix = camera_matrix_.clone();
+  camera_matrix.at<double>(1, 2) = image_height_ - camera_matrix.at<double>(1, 2);
+  return camera_matrix;
+
+}
+
+void Camera::SetupUndistortion(const std::string &cache_file){
+
+  if (!is_setup_)
+    throw std::runtime_error("Error, cannot set up undistortion before the camera calibration is loaded.\n");
+
+  const cv::Mat camera_matrix = GetOpenCVCameraMatrix();
+  const cv::Size image_size(image_width_, image_height_);
+
+  cv::Mat distortion;
+  distortion_params_.reshape(1, 1).convertTo(distortion, CV_64F);
+
+  if (LoadUndistortionMaps(cache_file, camera_matrix, distortion, image_size, undistort_map_xy_, undistort_map_interp_)) return;
+
+  //keep the same camera matrix for the undistorted image so the GL projection still lines up with it
+  cv::initUndistortRectifyMap(camera_matrix, distortion, cv::Mat(), camera_matrix, image_size, CV_16SC2, undistort_map_xy_, undistort_map_interp_);
+
+  SaveUndistortionMaps(cache_file, camera_matrix, distortion, undistort_map_xy_, undistort_map_interp_);
+
+}
+
+void Camera::SetupDistortionMap(const std::string &cache_file){
+
+  if (!is_setup_)
+    throw std::runtime_error("Error, cannot set up the distortion map before the camera calibration is loaded.\n");
+
+  const cv::Mat camera_matrix = GetOpenCVCameraMatrix();
+  const cv::Size image_size(image_width_, image_height_);
+
+  cv::Mat distortion;
+  distortion_params_.reshape(1, 1).convertTo(distortion, CV_64F);
+
+  if (LoadDistortionMap(cache_file, camera_matrix, distortion, image_size, distortion_map_)) return;
+
+  distortion_map_.create(image_size, CV_32FC2);
+
+  //undistorting each raw pixel centre gives where that ray lands in the pinhole image. rows count up from the bottom to match OpenGL textures.
+  ThreadPool::Compute().ParallelFor(0, image_height_, [&](size_t start_row, size_t end_row){
+
+    cv::Mat raw_points((int)(end_row - start_row) * image_width_, 1, CV_32FC2), pinhole_points;
+    for (size_t row = start_row; row < end_row; ++row){
+      for (int x = 0; x < image_width_; ++x){
+        raw_points.at<cv::Vec2f>((int)(row - start_row) * image_width_ + x) = cv::Vec2f(x + 0.5f, image_height_ - (row + 0.5f));
+      }
+    }
+
+    cv::undistortPoints(raw_points, pinhole_points, camera_matrix, distortion, cv::noArray(), camera_matrix);
+
+    for (size_t row = start_row; row < end_row; ++row){
+      cv::Vec2f *map_row = distortion_map_.ptr<cv::Vec2f>((int)row);
+      for (int x = 0; x < image_width_; ++x){
+        const cv::Vec2f &pinhole = pinhole_points.at<cv::Vec2f>((int)(row - start_row) * image_width_ + x);
+        map_row[x] = cv::Vec2f(pinhole[0] / image_width_, (image_height_ - pinhole[1]) / image_height_);
+      }
+    }
+
+  });
+
+  SaveDistortionMap(cache_file, camera_matrix, distortion, distortion_map_);
+
+}
+
+const cv::Mat &Camera::Undistort(const cv::Mat &image, cv::Mat &undistorted_buffer) const {
+
+  if (!CanUndistort() || image.size() != undistort_map_xy_.size()) return image;
+
+  undistorted_buffer.create(image.size(), image.type());
+
+  ThreadPool::Compute().ParallelFor(0, image.rows, [&](size_t start_row, size_t end_row){
+    cv::Mat stripe = undistorted_buffer.rowRange((int)start_row, (int)end_row);
+    cv::remap(image, stripe, undistort_map_xy_.rowRange((int)start_row, (int)end_row), undistort_map_interp_.rowRange((int)start_row, (int)end_row), cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+  });
+
+  return undistorted_buffer;
+
+}
+
+ci::Vec2f Camera::ProjectPoint(const ci::Vec3f &point, const bool apply_distortion) const {
+
+  if (point.z <= 0) return ci::Vec2f(-1, -1);
+
+  double x = point.x / point.z;
+  double y = point.y / point.z;
+
+  if (apply_distortion){
+
+    const double *k = distortion_coefficients_;
+    const double r2 = x*x + y*y;
+    const double r4 = r2*r2;
+    const double r6 = r4*r2;
+    const double radial = (1 + k[0] * r2 + k[1] * r4 + k[4] * r6) / (1 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+    const double xd = x * radial + 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x);
+    const double yd = y * radial + k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y;
+    x = xd;
+    y = yd;
+
+  }
+
+  //the principal point in camera_matrix_ is measured from the bottom of the image for OpenGL
+  const double u = camera_matrix_.at<double>(0, 0) * x + camera_matrix_.at<double>(0, 2);
+  const double v = camera_matrix_.at<double>(1, 1) * y + (image_height_ - camera_matrix_.at<double>(1, 2));
+
+  return ci::Vec2f((float)u, (float)v);
+
+}
+
+void Camera::ProjectPoints(const std::vector<ci::Vec3f> &points, const ci::Matrix44f &model_to_camera, const bool apply_distortion, std::vector<ci::Vec2f> &projected) const {
+
+  projected.resize(points.size());
+
+  for (size_t i = 0; i < points.size(); ++i){
+    projected[i] = ProjectPoint(model_to_camera.transformPointAffine(points[i]), apply_distortion);
+  }
+
+}
+
 void Camera::makeCurrentCamera() const {
 
   glMatrixMode(GL_PROJECTION);
@@ -64,6 +366,8 @@ void StereoCamera::Setup(const std::string &calibration_filename, const int near
   if(!boost::filesystem::exists(boost::filesystem::path(calibration_filename)))
     throw(std::runtime_error("Error, could not find camera calibration file: " + calibration_filename + "\n"));
 
+  calibration_filename_ = calibration_filename;
+
   cv::FileStorage fs;
 
   try{
@@ -108,6 +412,20 @@ void StereoCamera::Setup(const std::string &calibration_filename, const int near
 
 }
 
+void StereoCamera::SetupUndistortion(){
+
+  left_eye_.SetupUndistortion(calibration_filename_ + ".left.rmap");
+  right_eye_.SetupUndistortion(calibration_filename_ + ".right.rmap");
+
+}
+
+void StereoCamera::SetupDistortionMaps(){
+
+  left_eye_.SetupDistortionMap(calibration_filename_ + ".left.dmap");
+  right_eye_.SetupDistortionMap(calibration_filename_ + ".right.dmap");
+
+}
+
 void StereoCamera::convertBouguetToGLCoordinates(cv::Mat &left_camera_matrix, cv::Mat &right_camera_matrix, cv::Mat &extrinsic_rotation, cv::Mat &extrinsic_translation, const int image_width, const int image_height){
 
   //first flip the principal points
@@ -201,6 +519,25 @@ void StereoCamera::moveEyeToLeftCam(ci::MayaCamUI &cam, const ci::Matrix44f &cur
   left_eye_.makeCurrentCamera();
 }
 
+ci::Matrix44f StereoCamera::getLeftToRightTransform() const {
+
+  //moveEyeToRightCam puts the right eye at extrinsic_translation_ with its axes rotated by extrinsic_rotation_, so invert that
+  const ci::Matrix33f rotation = extrinsic_rotation_.transposed();
+  const ci::Vec3f translation = -(rotation * extrinsic_translation_);
+
+  ci::Matrix44f transform;
+  transform.setToIdentity();
+  for (int r = 0; r < 3; ++r){
+    for (int c = 0; c < 3; ++c){
+      transform.at(r, c) = rotation.at(r, c);
+    }
+    transform.at(r, 3) = translation[r];
+  }
+
+  return transform;
+
+}
+
 void StereoCamera::moveEyeToRightCam(ci::MayaCamUI &cam, const ci::Matrix44f &current_camera_pose){
 
   ci::CameraPersp camP;
@@ -0,0 +1,269 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/core_renderer.hpp"
+#include "../include/shader_snippets.hpp"
+#include <iostream>
+#include <cstring>
+
+using namespace viz;
+
+namespace {
+
+  const GLuint FRAME_BINDING = 0; /**< The uniform buffer binding point for the frame block. */
+  const GLuint DRAW_BINDING = 1; /**< The uniform buffer binding point for the draw block. */
+  const std::size_t NUM_DRAW_SLOTS = 256; /**< The number of draws the draw buffer holds before it's orphaned and reused. */
+
+  /**
+  * The frame block with std140 layout, the same as FrameUniforms in the shaders.
+  */
+  struct FrameBlock {
+    GLfloat projection[16];
+    GLfloat view[16];
+    GLfloat light_position[4];
+  };
+
+  /**
+  * The draw block with std140 layout, the same as DrawUniforms in the shaders.
+  */
+  struct DrawBlock {
+    GLfloat models[4][16];
+    GLfloat normal_matrices[4][16];
+    GLfloat packed_parts[4]; /**< The first element is 1 if the vertex colors pick the part, otherwise every vertex uses the first part. */
+  };
+
+  const char *UNIFORM_BLOCKS =
+    "#version 120\n"
+    "#extension GL_ARB_uniform_buffer_object : require\n"
+    "layout(std140) uniform FrameUniforms {\n"
+    "  mat4 projection;\n"
+    "  mat4 view;\n"
+    "  vec4 light_position;\n"
+    "};\n"
+    "layout(std140) uniform DrawUniforms {\n"
+    "  mat4 models[4];\n"
+    "  mat4 normal_matrices[4];\n"
+    "  vec4 packed_parts;\n"
+    "};\n";
+
+  //the packed instrument shader from model.cpp with the matrices from the uniform blocks. the view is rigid so it can rotate the normals as well.
+  const char *VERTEX_SHADER =
+    "varying vec3 v;\n"
+    "varying vec3 N;\n"
+    "varying vec4 part_weights;\n"
+    "void main()\n"
+    "{\n"
+    "  part_weights = packed_parts.x > 0.5 ? gl_Color : vec4(1.0, 0.0, 0.0, 0.0);\n"
+    "  int part = int(dot(part_weights, vec4(0.0, 1.0, 2.0, 3.0)) + 0.5);\n"
+    "  vec4 vertex = view * (models[part] * gl_Vertex);\n"
+    "  v = vertex.xyz;\n"
+    "  N = normalize(mat3(view) * (mat3(normal_matrices[part]) * gl_Normal));\n"
+    "  gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "  gl_Position = projection * vertex;\n"
+    "}\n";
+
+  //the lighting and the part's texel come from shader_snippets.hpp, the same as the packed instrument shader
+  const char *FRAGMENT_SHADER =
+    "varying vec3 v;\n"
+    "varying vec3 N;\n"
+    "varying vec4 part_weights;\n"
+    "void main()\n"
+    "{\n"
+    "  gl_FragColor = phongLighting(v, N, light_position.xyz) * partTexel(part_weights, gl_TexCoord[0].st);\n"
+    "}\n";
+
+  /**
+  * Point one of a shader's uniform blocks at a binding point.
+  * @param[in] shader The shader.
+  * @param[in] name The name of the block.
+  * @param[in] binding The binding point.
+  * @return False if the shader doesn't have the block.
+  */
+  bool BindUniformBlock(ci::gl::GlslProg &shader, const char *name, const GLuint binding){
+
+    const GLuint index = glGetUniformBlockIndex(shader.getHandle(), name);
+    if (index == GL_INVALID_INDEX) return false;
+
+    glUniformBlockBinding(shader.getHandle(), index, binding);
+    return true;
+
+  }
+
+}
+
+CoreRenderer *CoreRenderer::current_ = 0;
+
+bool CoreRenderer::IsSupported(){
+
+  return ci::gl::isExtensionAvailable("GL_ARB_uniform_buffer_object") && ci::gl::isExtensionAvailable("GL_ARB_vertex_array_object");
+
+}
+
+void CoreRenderer::Setup(){
+
+  Release();
+
+  ci::gl::GlslProg shader;
+  try{
+    shader = ci::gl::GlslProg((std::string(UNIFORM_BLOCKS) + VERTEX_SHADER).c_str(), (std::string(UNIFORM_BLOCKS) + PhongLightingSnippet() + PartTextureSnippet() + FRAGMENT_SHADER).c_str());
+  }
+  catch (ci::gl::GlslProgCompileExc &e){
+    std::cerr << "Warning, could not compile the core renderer's shader, drawing with the fixed function state.\n" << e.what() << std::endl;
+    return;
+  }
+
+  if (!BindUniformBlock(shader, "FrameUniforms", FRAME_BINDING) || !BindUniformBlock(shader, "DrawUniforms", DRAW_BINDING)){
+    std::cerr << "Warning, the core renderer's shader is missing its uniform blocks, drawing with the fixed function state." << std::endl;
+    return;
+  }
+
+  //the samplers are shader state so they only need setting once
+  shader.bind();
+  shader.uniform("tex0", 0);
+  shader.uniform("tex1", 1);
+  shader.uniform("tex2", 2);
+  shader.uniform("tex3", 3);
+  shader.unbind();
+
+  GLint alignment = 1;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  draw_stride_ = ((sizeof(DrawBlock) + alignment - 1) / alignment) * alignment;
+
+  frame_uniforms_ = ci::gl::Vbo(GL_UNIFORM_BUFFER);
+  frame_uniforms_.bufferData(sizeof(FrameBlock), 0, GL_STREAM_DRAW);
+  draw_uniforms_ = ci::gl::Vbo(GL_UNIFORM_BUFFER);
+  draw_uniforms_.bufferData(NUM_DRAW_SLOTS * draw_stride_, 0, GL_STREAM_DRAW);
+  next_draw_ = 0;
+
+  shader_ = shader;
+
+}
+
+void CoreRenderer::BeginFrame(const ci::Matrix44f &projection, const ci::Matrix44f &view, const ci::Vec3f &light_position){
+
+  FrameBlock frame;
+  std::memcpy(frame.projection, projection.m, sizeof(frame.projection));
+  std::memcpy(frame.view, view.m, sizeof(frame.view));
+  frame.light_position[0] = light_position.x;
+  frame.light_position[1] = light_position.y;
+  frame.light_position[2] = light_position.z;
+  frame.light_position[3] = 1;
+
+  //respecifying the whole buffer orphans the last frame's copy rather than waiting for draws which still read it
+  frame_uniforms_.bufferData(sizeof(FrameBlock), &frame, GL_STREAM_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frame_uniforms_.getId());
+
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program_);
+  shader_.bind();
+
+  current_ = this;
+
+}
+
+void CoreRenderer::EndFrame(){
+
+  current_ = 0;
+
+  glBindVertexArray(0);
+  glUseProgram(previous_program_);
+
+}
+
+void CoreRenderer::Draw(const ci::gl::VboMesh &vbo, const ci::Matrix44f &model){
+
+  DrawInternal(vbo, &model, 1);
+
+}
+
+void CoreRenderer::DrawParts(const ci::gl::VboMesh &vbo, const std::vector<ci::Matrix44f> &models){
+
+  if (models.empty() || models.size() > 4){
+    throw std::runtime_error("Error, a packed mesh must have between one and four parts.");
+  }
+
+  DrawInternal(vbo, &models[0], models.size());
+
+}
+
+void CoreRenderer::DrawInternal(const ci::gl::VboMesh &vbo, const ci::Matrix44f *models, const std::size_t num_models){
+
+  DrawBlock draw;
+  std::memset(&draw, 0, sizeof(draw));
+  for (std::size_t i = 0; i < num_models; ++i){
+    const ci::Matrix44f normal_matrix = models[i].inverted().transposed();
+    std::memcpy(draw.models[i], models[i].m, sizeof(draw.models[i]));
+    std::memcpy(draw.normal_matrices[i], normal_matrix.m, sizeof(draw.normal_matrices[i]));
+  }
+  draw.packed_parts[0] = num_models > 1 ? 1.0f : 0.0f;
+
+  //each draw gets its own slot so writing it never waits on an earlier draw, when the ring is full the storage is orphaned and the ring starts again
+  if (next_draw_ == NUM_DRAW_SLOTS){
+    draw_uniforms_.bufferData(NUM_DRAW_SLOTS * draw_stride_, 0, GL_STREAM_DRAW);
+    next_draw_ = 0;
+  }
+
+  const std::size_t offset = next_draw_++ * draw_stride_;
+  draw_uniforms_.bufferSubData(offset, sizeof(DrawBlock), &draw);
+  glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_BINDING, draw_uniforms_.getId(), offset, sizeof(DrawBlock));
+
+  glBindVertexArray(VertexArray(vbo));
+
+  if (vbo.getNumIndices() > 0){
+    glDrawElements(vbo.getPrimitiveType(), (GLsizei)vbo.getNumIndices(), GL_UNSIGNED_INT, 0);
+  }
+  else{
+    glDrawArrays(vbo.getPrimitiveType(), 0, (GLsizei)vbo.getNumVertices());
+  }
+
+}
+
+GLuint CoreRenderer::VertexArray(const ci::gl::VboMesh &vbo){
+
+  //every mesh has its own static buffer and the meshes stay loaded until the next session, when Setup() drops the arrays
+  const GLuint key = vbo.getStaticVbo().getId();
+
+  std::map<GLuint, GLuint>::const_iterator it = vertex_arrays_.find(key);
+  if (it != vertex_arrays_.end()) return it->second;
+
+  GLuint vertex_array = 0;
+  glGenVertexArrays(1, &vertex_array);
+
+  //the client arrays and the index buffer are recorded in the vertex array, so drawing only has to bind it
+  glBindVertexArray(vertex_array);
+  vbo.enableClientStates();
+  vbo.bindAllData();
+  glBindVertexArray(0);
+  ci::gl::VboMesh::unbindBuffers();
+
+  vertex_arrays_[key] = vertex_array;
+  return vertex_array;
+
+}
+
+void CoreRenderer::Release(){
+
+  shader_ = ci::gl::GlslProg();
+
+  for (std::map<GLuint, GLuint>::iterator it = vertex_arrays_.begin(); it != vertex_arrays_.end(); ++it){
+    glDeleteVertexArrays(1, &it->second);
+  }
+  vertex_arrays_.clear();
+
+}
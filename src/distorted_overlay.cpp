@@ -0,0 +1,166 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/distorted_overlay.hpp"
+#include <cinder/gl/GlslProg.h>
+#include <iostream>
+
+using namespace viz;
+
+namespace {
+
+  //the quad is given in clip coordinates so no matrices are needed
+  const char *DISTORT_VERTEX_SHADER =
+    "#version 120\n"
+    "varying vec2 raw_coord;\n"
+    "void main()\n"
+    "{\n"
+    "  raw_coord = gl_MultiTexCoord0.st;\n"
+    "  gl_Position = gl_Vertex;\n"
+    "}\n";
+
+  //look up where each raw pixel is in the pinhole overlay, anything which maps off the overlay is left transparent
+  const char *DISTORT_FRAGMENT_SHADER =
+    "#version 120\n"
+    "uniform sampler2D overlay;\n"
+    "uniform sampler2D distortion_map;\n"
+    "varying vec2 raw_coord;\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 overlay_coord = texture2D(distortion_map, raw_coord).xy;\n"
+    "  if (any(lessThan(overlay_coord, vec2(0.0))) || any(greaterThan(overlay_coord, vec2(1.0)))) discard;\n"
+    "  gl_FragColor = texture2D(overlay, overlay_coord);\n"
+    "}\n";
+
+  /**
+  * Get the warp shader, compiling it the first time it's needed.
+  * @return The shader, or an empty one if it failed to compile.
+  */
+  ci::gl::GlslProg &DistortShader(){
+
+    static ci::gl::GlslProg shader;
+    static bool compiled = false;
+
+    if (!compiled){
+      compiled = true;
+      try{
+        shader = ci::gl::GlslProg(DISTORT_VERTEX_SHADER, DISTORT_FRAGMENT_SHADER);
+      }
+      catch (ci::gl::GlslProgCompileExc &e){
+        std::cerr << "Warning, could not compile the overlay distortion shader, drawing overlays undistorted.\n" << e.what() << std::endl;
+      }
+    }
+
+    return shader;
+
+  }
+
+}
+
+void DistortedOverlay::Setup(const Camera &camera){
+
+  const cv::Mat &map = camera.GetDistortionMap();
+  if (map.empty()) throw std::runtime_error("Error, the camera's distortion map has not been set up.\n");
+
+  if (!DistortShader()) return;
+
+  //the map's third channel is unused, it's only there as two channel float textures need a newer OpenGL
+  cv::Mat map_channels[3], padded_map;
+  cv::split(map, map_channels);
+  map_channels[2] = cv::Mat::zeros(map.size(), CV_32FC1);
+  cv::merge(map_channels, 3, padded_map);
+
+  GLuint texture_id = 0;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+
+  //one texel per raw pixel, sampled at its centre, so there's nothing to filter
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  GLint unpack_alignment;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F_ARB, padded_map.cols, padded_map.rows, 0, GL_RGB, GL_FLOAT, padded_map.data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  distortion_map_ = ci::gl::Texture(GL_TEXTURE_2D, texture_id, padded_map.cols, padded_map.rows, false);
+
+  //the overlay is drawn at the camera resolution, with an alpha channel so the image shows through where nothing is drawn
+  ci::gl::Fbo::Format format;
+  format.setColorInternalFormat(GL_RGBA8);
+  framebuffer_ = ci::gl::Fbo(camera.getImageWidth(), camera.getImageHeight(), format);
+
+}
+
+void DistortedOverlay::Begin(){
+
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &previous_framebuffer_);
+
+  framebuffer_.bindFramebuffer();
+  ci::gl::clear(ci::ColorA(0, 0, 0, 0));
+
+}
+
+void DistortedOverlay::End(){
+
+  //Fbo::unbindFramebuffer() would go back to the window rather than to the framebuffer the eye view is being drawn into
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, previous_framebuffer_);
+
+  GLint current_program = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &current_program);
+  glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_VIEWPORT_BIT);
+
+  //the raw image is drawn at the bottom left at the camera resolution, see Session::draw2D()
+  glViewport(0, 0, framebuffer_.getWidth(), framebuffer_.getHeight());
+
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_LIGHTING);
+
+  //the overlay is cleared to transparent black and drawn opaque, so its filtered texels are already premultiplied by alpha
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+  ci::gl::GlslProg &shader = DistortShader();
+  shader.bind();
+  shader.uniform("overlay", 0);
+  shader.uniform("distortion_map", 1);
+
+  framebuffer_.bindTexture(0);
+  distortion_map_.bind(1);
+
+  glBegin(GL_QUADS);
+  glTexCoord2f(0, 0); glVertex2f(-1, -1);
+  glTexCoord2f(1, 0); glVertex2f(1, -1);
+  glTexCoord2f(1, 1); glVertex2f(1, 1);
+  glTexCoord2f(0, 1); glVertex2f(-1, 1);
+  glEnd();
+
+  distortion_map_.unbind(1);
+  framebuffer_.unbindTexture();
+
+  glPopAttrib();
+  glUseProgram(current_program);
+
+}
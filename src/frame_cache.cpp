@@ -0,0 +1,177 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/frame_cache.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+using namespace viz;
+
+namespace {
+
+  const char FRAME_CACHE_MAGIC[4] = { 'V', 'F', 'R', 'C' };
+  const boost::uint32_t FRAME_CACHE_VERSION = 1;
+  const boost::uint64_t EMPTY_SLOT = ~boost::uint64_t(0);
+  const std::size_t SLOT_ALIGNMENT = 4096;
+
+  std::size_t AlignToPage(const std::size_t bytes){
+    return (bytes + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+  }
+
+}
+
+struct FrameCache::Header {
+  char magic[4];
+  boost::uint32_t version;
+  boost::int32_t width;
+  boost::int32_t height;
+  boost::int32_t type;
+  boost::uint32_t padding;
+  boost::uint64_t num_slots;
+  boost::uint64_t source_size;
+  boost::int64_t source_time;
+  boost::uint64_t tick; /**< Incremented on every access, used as the LRU clock. */
+};
+
+struct FrameCache::Slot {
+  boost::uint64_t frame; /**< The frame in this slot or EMPTY_SLOT. */
+  boost::uint64_t last_used; /**< The tick when this slot was last read or written. */
+};
+
+FrameCache::FrameCache(const std::string &video_path, const cv::Size &frame_size, const int type, const std::size_t budget_bytes) :
+  cache_path_(video_path + ".frames"), frame_size_(frame_size), type_(type) {
+
+  frame_bytes_ = frame_size.area() * CV_ELEM_SIZE(type);
+  if (frame_bytes_ == 0) throw std::runtime_error("Error, cannot cache empty frames");
+
+  slot_stride_ = AlignToPage(frame_bytes_);
+  num_slots_ = std::max<std::size_t>(1, budget_bytes / slot_stride_);
+
+  const std::size_t table_bytes = AlignToPage(sizeof(Header) + num_slots_ * sizeof(Slot));
+  const boost::uint64_t file_bytes = (boost::uint64_t)table_bytes + (boost::uint64_t)num_slots_ * slot_stride_;
+
+  const boost::uint64_t source_size = boost::filesystem::file_size(video_path);
+  const boost::int64_t source_time = boost::filesystem::last_write_time(video_path);
+
+  //a cache with a different budget or frame size has a different file size, so recreate it
+  bool is_valid = boost::filesystem::exists(cache_path_) && boost::filesystem::file_size(cache_path_) == file_bytes;
+  if (!is_valid){
+    std::ofstream create(cache_path_.c_str(), std::ios::binary | std::ios::trunc);
+    if (!create.is_open()) throw std::runtime_error("Error, could not create frame cache " + cache_path_);
+    create.close();
+    boost::filesystem::resize_file(cache_path_, file_bytes);
+  }
+
+  boost::interprocess::file_mapping mapping(cache_path_.c_str(), boost::interprocess::read_write);
+  boost::interprocess::mapped_region region(mapping, boost::interprocess::read_write);
+  region_.swap(region);
+
+  unsigned char *base = static_cast<unsigned char *>(region_.get_address());
+  header_ = reinterpret_cast<Header *>(base);
+  slots_ = reinterpret_cast<Slot *>(base + sizeof(Header));
+  data_ = base + table_bytes;
+
+  is_valid = is_valid &&
+    std::equal(header_->magic, header_->magic + 4, FRAME_CACHE_MAGIC) &&
+    header_->version == FRAME_CACHE_VERSION &&
+    header_->width == frame_size_.width &&
+    header_->height == frame_size_.height &&
+    header_->type == type_ &&
+    header_->num_slots == num_slots_ &&
+    header_->source_size == source_size &&
+    header_->source_time == source_time;
+
+  if (!is_valid){
+    Reset(source_size, source_time);
+    return;
+  }
+
+  for (std::size_t i = 0; i < num_slots_; ++i){
+    if (slots_[i].frame != EMPTY_SLOT) index_[(std::size_t)slots_[i].frame] = i;
+  }
+
+}
+
+void FrameCache::Reset(const boost::uint64_t source_size, const boost::int64_t source_time){
+
+  std::copy(FRAME_CACHE_MAGIC, FRAME_CACHE_MAGIC + 4, header_->magic);
+  header_->version = FRAME_CACHE_VERSION;
+  header_->width = frame_size_.width;
+  header_->height = frame_size_.height;
+  header_->type = type_;
+  header_->padding = 0;
+  header_->num_slots = num_slots_;
+  header_->source_size = source_size;
+  header_->source_time = source_time;
+  header_->tick = 0;
+
+  for (std::size_t i = 0; i < num_slots_; ++i){
+    slots_[i].frame = EMPTY_SLOT;
+    slots_[i].last_used = 0;
+  }
+
+  index_.clear();
+
+}
+
+bool FrameCache::Get(const std::size_t frame, cv::Mat &image){
+
+  std::map<std::size_t, std::size_t>::const_iterator it = index_.find(frame);
+  if (it == index_.end()) return false;
+
+  slots_[it->second].last_used = ++header_->tick;
+
+  image.create(frame_size_, type_);
+  std::memcpy(image.data, SlotData(it->second), frame_bytes_);
+
+  return true;
+
+}
+
+void FrameCache::Put(const std::size_t frame, const cv::Mat &image){
+
+  if (image.size() != frame_size_ || image.type() != type_ || Contains(frame)) return;
+
+  //use an empty slot if there is one, otherwise the least recently used
+  std::size_t victim = 0;
+  for (std::size_t i = 0; i < num_slots_; ++i){
+    if (slots_[i].frame == EMPTY_SLOT){
+      victim = i;
+      break;
+    }
+    if (slots_[i].last_used < slots_[victim].last_used) victim = i;
+  }
+
+  if (slots_[victim].frame != EMPTY_SLOT) index_.erase((std::size_t)slots_[victim].frame);
+
+  //mark the slot empty while it's being written so a crash never leaves a half written frame in the table
+  slots_[victim].frame = EMPTY_SLOT;
+
+  cv::Mat slot_image(frame_size_, type_, SlotData(victim));
+  image.copyTo(slot_image);
+
+  slots_[victim].frame = frame;
+  slots_[victim].last_used = ++header_->tick;
+  index_[frame] = victim;
+
+}
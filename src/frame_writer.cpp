@@ -0,0 +1,200 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/frame_writer.hpp"
+#include "../include/thread_pool.hpp"
+#include <opencv2/highgui/highgui.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <vector>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <boost/cstdint.hpp>
+
+using namespace viz;
+
+namespace {
+
+  const char GROUND_TRUTH_MAGIC[4] = { 'V', 'Z', 'G', 'T' };
+  const boost::uint32_t GROUND_TRUTH_VERSION = 1;
+
+  const std::size_t FRAMES_PER_VIDEO_FILE = 2000; /**< Start a new AVI file after this many frames. */
+
+}
+
+boost::shared_ptr<FrameWriter> viz::OpenFrameWriter(const std::string &save_format, const std::string &directory, const std::string &name, const cv::Size &frame_size, const int png_compression){
+
+  if (save_format == "png"){
+    return boost::shared_ptr<FrameWriter>(new FrameSequenceWriter(directory + "/" + name, name, png_compression));
+  }
+
+  return boost::shared_ptr<FrameWriter>(new VideoFileWriter(directory, name, frame_size));
+
+}
+
+VideoFileWriter::VideoFileWriter(const std::string &directory, const std::string &prefix, const cv::Size &frame_size) :
+  directory_(directory), prefix_(prefix), frame_size_(frame_size), file_count_(0), frames_in_file_(0) {
+
+  if (!boost::filesystem::exists(directory_)){
+    boost::filesystem::create_directories(directory_);
+  }
+
+  OpenNextFile();
+
+}
+
+void VideoFileWriter::OpenNextFile(){
+
+  writer_.release();
+
+  std::stringstream filepath;
+  filepath << directory_ << "/" << prefix_ << "_" << file_count_ << ".avi";
+  file_count_++;
+  frames_in_file_ = 0;
+
+  if (!writer_.open(filepath.str(), CV_FOURCC('D', 'I', 'B', ' '), 25, frame_size_)){
+    std::cerr << "Warning, could not open " << filepath.str() << " for writing.\n";
+  }
+
+}
+
+void VideoFileWriter::Write(const cv::Mat &frame){
+
+  if (frames_in_file_ == FRAMES_PER_VIDEO_FILE){
+    OpenNextFile();
+  }
+
+  frames_in_file_++;
+  writer_.write(frame);
+
+}
+
+FrameSequenceWriter::FrameSequenceWriter(const std::string &directory, const std::string &prefix, const int png_compression) :
+  directory_(directory), prefix_(prefix), png_compression_(std::min(9, std::max(0, png_compression))), frame_count_(0) {
+
+  if (!boost::filesystem::exists(directory_)){
+    boost::filesystem::create_directories(directory_);
+  }
+
+  //enough to keep every thread busy with one waiting, without buffering a long recording in memory
+  max_in_flight_ = 2 * ThreadPool::Shared().Size();
+
+}
+
+FrameSequenceWriter::~FrameSequenceWriter(){
+
+  try{
+    Flush();
+  }
+  catch (std::exception &e){
+    std::cerr << "Error, failed to write frame: " << e.what() << "\n";
+  }
+
+}
+
+std::string FrameSequenceWriter::NextPath(const std::string &extension){
+
+  std::stringstream filepath;
+  filepath << directory_ << "/" << prefix_ << "_" << std::setw(6) << std::setfill('0') << frame_count_ << extension;
+  frame_count_++;
+
+  return filepath.str();
+
+}
+
+void FrameSequenceWriter::Queue(const std::function<void()> &job){
+
+  while (in_flight_.size() >= max_in_flight_){
+    RetireOldest();
+  }
+
+  in_flight_.push_back(ThreadPool::Shared().Submit(job));
+
+}
+
+void FrameSequenceWriter::Write(const cv::Mat &frame){
+
+  const std::string path = NextPath(".png");
+  const cv::Mat image = frame.clone();
+  const int png_compression = png_compression_;
+
+  Queue([path, image, png_compression](){
+
+    std::vector<int> params;
+    params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+    params.push_back(png_compression);
+
+    if (!cv::imwrite(path, image, params)) throw std::runtime_error("Error, could not write " + path);
+
+  });
+
+}
+
+void GroundTruthWriter::Write(const cv::Mat &depth, const cv::Mat &normals, const cv::Mat &labels){
+
+  if (depth.type() != CV_32FC1 || normals.type() != CV_32FC3 || labels.type() != CV_8UC1 || depth.size() != normals.size() || depth.size() != labels.size())
+    throw std::runtime_error("Error, ground truth images must be matching CV_32FC1 depth, CV_32FC3 normals and CV_8UC1 labels.\n");
+
+  const std::string path = NextPath(".vizgt");
+  const cv::Mat depth_copy = depth.clone(), normals_copy = normals.clone(), labels_copy = labels.clone();
+
+  Queue([path, depth_copy, normals_copy, labels_copy](){
+
+    //the normals are unit length so 16 bit fixed point loses nothing that matters and halves their size
+    cv::Mat packed_normals;
+    normals_copy.convertTo(packed_normals, CV_16SC3, 32767.0);
+
+    const boost::uint32_t header[3] = { GROUND_TRUTH_VERSION, (boost::uint32_t)depth_copy.cols, (boost::uint32_t)depth_copy.rows };
+
+    //write to a temporary file and rename so a reader never sees a partly written frame
+    const std::string temp_path = path + ".tmp";
+    {
+      std::ofstream ofs(temp_path.c_str(), std::ios::binary);
+      ofs.write(GROUND_TRUTH_MAGIC, 4);
+      ofs.write(reinterpret_cast<const char *>(header), sizeof(header));
+      ofs.write(reinterpret_cast<const char *>(depth_copy.data), depth_copy.total() * depth_copy.elemSize());
+      ofs.write(reinterpret_cast<const char *>(packed_normals.data), packed_normals.total() * packed_normals.elemSize());
+      ofs.write(reinterpret_cast<const char *>(labels_copy.data), labels_copy.total() * labels_copy.elemSize());
+      if (!ofs) throw std::runtime_error("Error, could not write " + path);
+    }
+
+    boost::filesystem::rename(temp_path, path);
+
+  });
+
+}
+
+void FrameSequenceWriter::Flush(){
+
+  while (!in_flight_.empty()){
+    RetireOldest();
+  }
+
+}
+
+void FrameSequenceWriter::RetireOldest(){
+
+  std::future<void> oldest = std::move(in_flight_.front());
+  in_flight_.pop_front();
+  oldest.get();
+
+}
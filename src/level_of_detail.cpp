@@ -0,0 +1,45 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/level_of_detail.hpp"
+#include <cinder/gl/gl.h>
+#include <limits>
+
+float viz::PixelsPerUnit(const ci::Sphere &bounds, const ci::Matrix44f &transform){
+
+  GLfloat projection_data[16], modelview_data[16];
+  GLint viewport[4];
+  glGetFloatv(GL_PROJECTION_MATRIX, projection_data);
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelview_data);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  const ci::Matrix44f projection(projection_data);
+  const ci::Matrix44f modelview = ci::Matrix44f(modelview_data) * transform;
+  const float pixels_per_unit_at_unit_depth = 0.5f * viewport[3] * projection.at(1, 1);
+
+  //orthographic projection, the scale is the same everywhere
+  if (projection.at(3, 2) == 0.0f) return pixels_per_unit_at_unit_depth;
+
+  const float nearest_depth = -modelview.transformPointAffine(bounds.getCenter()).z - bounds.getRadius();
+  if (nearest_depth <= 0.0f) return std::numeric_limits<float>::max();
+
+  return pixels_per_unit_at_unit_depth / nearest_depth;
+
+}
@@ -0,0 +1,56 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <iostream>
+#include <string>
+
+#include "../include/mask_renderer.hpp"
+
+int main(int argc, char **argv){
+
+  //the masks and ground truth are drawn on the CPU, so unlike viz-batch there is no OpenGL context to create
+  const bool ground_truth = argc > 1 && std::string(argv[1]) == "--ground-truth";
+  const int first_config = ground_truth ? 2 : 1;
+
+  if (argc <= first_config){
+    std::cerr << "Usage: viz-masks [--ground-truth] /path/to/config.cfg [/path/to/another/config.cfg ...]\n";
+    return 1;
+  }
+
+  int num_failed = 0;
+
+  //each session is independent so one bad config doesn't stop the rest
+  for (int i = first_config; i < argc; ++i){
+
+    try{
+      viz::MaskRenderer renderer(ground_truth);
+      const size_t frame_count = renderer.Run(argv[i]);
+      std::cout << "Drew " << (ground_truth ? "ground truth" : "masks") << " for " << frame_count << " frames from " << argv[i] << std::endl;
+    }
+    catch (std::exception &e){
+      std::cerr << "Error drawing " << (ground_truth ? "ground truth" : "masks") << " for " << argv[i] << ": " << e.what() << std::endl;
+      num_failed++;
+    }
+
+  }
+
+  return num_failed == 0 ? 0 : 1;
+
+}
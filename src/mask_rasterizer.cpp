@@ -0,0 +1,285 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/mask_rasterizer.hpp"
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace viz;
+
+namespace {
+
+  const int TILE_SIZE = 64; /**< The width and height of a tile in pixels. */
+
+  /**
+  * Check which side of the edge from a to b a point is. Positive inside a triangle with positive area, in pixel coordinates (y down).
+  */
+  inline float EdgeFunction(const float ax, const float ay, const float bx, const float by, const float px, const float py){
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+  }
+
+  /**
+  * Whether pixels exactly on the edge from a to b belong to the triangle. Reversing the edge flips the answer, so of two triangles sharing an edge
+  * exactly one of them owns it.
+  */
+  inline bool OwnsEdge(const float ax, const float ay, const float bx, const float by){
+    return by < ay || (by == ay && bx > ax);
+  }
+
+  /**
+  * Find where the line from a to b crosses the plane z = depth, interpolating the normal too.
+  */
+  template<typename Vertex>
+  inline Vertex IntersectDepth(const Vertex &a, const Vertex &b, const float depth){
+    const float t = (depth - a.point.z) / (b.point.z - a.point.z);
+    Vertex intersection;
+    intersection.point = ci::Vec3f(a.point.x + t * (b.point.x - a.point.x), a.point.y + t * (b.point.y - a.point.y), depth);
+    intersection.normal = a.normal + (b.normal - a.normal) * t;
+    return intersection;
+  }
+
+}
+
+MaskRasterizer::MaskRasterizer(const Camera &camera, const float near_clip) : camera_(camera), near_clip_(near_clip) {
+
+  tiles_x_ = (camera_.getImageWidth() + TILE_SIZE - 1) / TILE_SIZE;
+  tiles_y_ = (camera_.getImageHeight() + TILE_SIZE - 1) / TILE_SIZE;
+
+}
+
+void MaskRasterizer::Draw(const std::vector<Instance> &instances, cv::Mat &labels, cv::Mat *depth, cv::Mat *normals){
+
+  labels.create(camera_.getImageHeight(), camera_.getImageWidth(), CV_8UC1);
+  if (depth) depth->create(labels.size(), CV_32FC1);
+  if (normals) normals->create(labels.size(), CV_32FC3);
+  inverse_depth_.resize(labels.total());
+
+  triangles_.resize(instances.size());
+  bins_.resize(instances.size());
+
+  //the compute pool, as the mask and ground truth writers keep the shared pool busy encoding earlier frames
+  ThreadPool &pool = ThreadPool::Compute();
+
+  pool.ParallelFor(0, instances.size(), [&](std::size_t start, std::size_t end){
+    for (std::size_t i = start; i < end; ++i){
+      SetupInstance(instances[i], triangles_[i], bins_[i]);
+    }
+  });
+
+  //the models only cover a few of the tiles, so deal the tiles out round robin rather than in blocks to spread the busy ones over the threads
+  const std::size_t num_tiles = tiles_x_ * tiles_y_;
+  const std::size_t num_workers = std::min(num_tiles, pool.Size() + 1);
+
+  pool.ParallelFor(0, num_workers, [&](std::size_t start, std::size_t end){
+    for (std::size_t worker = start; worker < end; ++worker){
+      for (std::size_t tile = worker; tile < num_tiles; tile += num_workers){
+        DrawTile(tile, instances, labels, depth, normals);
+      }
+    }
+  });
+
+}
+
+void MaskRasterizer::SetupInstance(const Instance &instance, std::vector<ScreenTriangle> &triangles, std::vector< std::vector<boost::uint32_t> > &bins) const {
+
+  triangles.clear();
+  bins.resize(tiles_x_ * tiles_y_);
+  for (std::size_t i = 0; i < bins.size(); ++i){
+    bins[i].clear();
+  }
+
+  if (!instance.mesh) return;
+
+  const std::vector<ci::Vec3f> &vertices = instance.mesh->getVertices();
+  const std::vector<ci::Vec3f> &vertex_normals = instance.mesh->getNormals();
+  const std::vector<uint32_t> &indices = instance.mesh->getIndices();
+  const bool has_normals = vertex_normals.size() == vertices.size();
+
+  std::vector<CameraVertex> points(vertices.size());
+  for (std::size_t i = 0; i < vertices.size(); ++i){
+    points[i].point = instance.model_to_camera.transformPointAffine(vertices[i]);
+    if (has_normals) points[i].normal = instance.model_to_camera.transformVec(vertex_normals[i]);
+  }
+
+  for (std::size_t i = 0; i + 2 < indices.size(); i += 3){
+
+    CameraVertex corners[3] = { points[indices[i]], points[indices[i + 1]], points[indices[i + 2]] };
+
+    int num_in_front = 0;
+    for (int c = 0; c < 3; ++c){
+      if (corners[c].point.z >= near_clip_) num_in_front++;
+    }
+
+    if (num_in_front == 0) continue;
+
+    //without vertex normals use the face normal, turned towards the camera as the winding isn't reliable
+    if (!has_normals){
+      ci::Vec3f face_normal = (corners[1].point - corners[0].point).cross(corners[2].point - corners[0].point).safeNormalized();
+      if (face_normal.dot(corners[0].point) > 0) face_normal = -face_normal;
+      for (int c = 0; c < 3; ++c) corners[c].normal = face_normal;
+    }
+
+    if (num_in_front == 3){
+      AddTriangle(corners[0], corners[1], corners[2], triangles);
+      continue;
+    }
+
+    //clip against the near plane, which leaves a triangle or a quad
+    CameraVertex clipped[4];
+    int num_clipped = 0;
+    for (int c = 0; c < 3; ++c){
+      const CameraVertex &current = corners[c];
+      const CameraVertex &next = corners[(c + 1) % 3];
+      if (current.point.z >= near_clip_) clipped[num_clipped++] = current;
+      if ((current.point.z >= near_clip_) != (next.point.z >= near_clip_)) clipped[num_clipped++] = IntersectDepth(current, next, near_clip_);
+    }
+
+    AddTriangle(clipped[0], clipped[1], clipped[2], triangles);
+    if (num_clipped == 4) AddTriangle(clipped[0], clipped[2], clipped[3], triangles);
+
+  }
+
+  for (std::size_t t = 0; t < triangles.size(); ++t){
+    const ScreenTriangle &tri = triangles[t];
+    for (int ty = tri.min_y / TILE_SIZE; ty <= tri.max_y / TILE_SIZE; ++ty){
+      for (int tx = tri.min_x / TILE_SIZE; tx <= tri.max_x / TILE_SIZE; ++tx){
+        bins[ty * tiles_x_ + tx].push_back((boost::uint32_t)t);
+      }
+    }
+  }
+
+}
+
+void MaskRasterizer::AddTriangle(const CameraVertex &a, const CameraVertex &b, const CameraVertex &c, std::vector<ScreenTriangle> &triangles) const {
+
+  const CameraVertex *corners[3] = { &a, &b, &c };
+
+  ScreenTriangle tri;
+  for (int i = 0; i < 3; ++i){
+    const ci::Vec2f pixel = camera_.ProjectPoint(corners[i]->point, false);
+    tri.x[i] = pixel.x;
+    tri.y[i] = pixel.y;
+    tri.inverse_depth[i] = 1.0f / corners[i]->point.z;
+    tri.normal[i] = corners[i]->normal * tri.inverse_depth[i];
+  }
+
+  const float area = EdgeFunction(tri.x[0], tri.y[0], tri.x[1], tri.y[1], tri.x[2], tri.y[2]);
+  if (area == 0.0f || area != area) return;
+
+  //the meshes aren't consistently wound and nothing is culled, so just flip the triangles which face away
+  if (area < 0){
+    std::swap(tri.x[1], tri.x[2]);
+    std::swap(tri.y[1], tri.y[2]);
+    std::swap(tri.inverse_depth[1], tri.inverse_depth[2]);
+    std::swap(tri.normal[1], tri.normal[2]);
+  }
+
+  //pixel centres are at +0.5, clamp in floating point first as clipped triangles can project a long way off screen
+  const float max_x = (float)camera_.getImageWidth() - 1, max_y = (float)camera_.getImageHeight() - 1;
+  tri.min_x = (int)std::max(0.0f, std::ceil(std::min(tri.x[0], std::min(tri.x[1], tri.x[2])) - 0.5f));
+  tri.min_y = (int)std::max(0.0f, std::ceil(std::min(tri.y[0], std::min(tri.y[1], tri.y[2])) - 0.5f));
+  tri.max_x = (int)std::min(max_x, std::floor(std::max(tri.x[0], std::max(tri.x[1], tri.x[2])) - 0.5f));
+  tri.max_y = (int)std::min(max_y, std::floor(std::max(tri.y[0], std::max(tri.y[1], tri.y[2])) - 0.5f));
+
+  if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) return;
+
+  triangles.push_back(tri);
+
+}
+
+void MaskRasterizer::DrawTile(const std::size_t tile, const std::vector<Instance> &instances, cv::Mat &labels, cv::Mat *depth, cv::Mat *normals){
+
+  const int width = labels.cols;
+  const int tile_min_x = (int)(tile % tiles_x_) * TILE_SIZE;
+  const int tile_min_y = (int)(tile / tiles_x_) * TILE_SIZE;
+  const int tile_max_x = std::min(tile_min_x + TILE_SIZE, labels.cols) - 1;
+  const int tile_max_y = std::min(tile_min_y + TILE_SIZE, labels.rows) - 1;
+
+  for (int y = tile_min_y; y <= tile_max_y; ++y){
+    std::fill(labels.ptr<boost::uint8_t>(y) + tile_min_x, labels.ptr<boost::uint8_t>(y) + tile_max_x + 1, 0);
+    std::fill(inverse_depth_.begin() + y * width + tile_min_x, inverse_depth_.begin() + y * width + tile_max_x + 1, 0.0f);
+    if (normals) std::fill(normals->ptr<ci::Vec3f>(y) + tile_min_x, normals->ptr<ci::Vec3f>(y) + tile_max_x + 1, ci::Vec3f::zero());
+  }
+
+  for (std::size_t i = 0; i < instances.size(); ++i){
+
+    const std::vector<boost::uint32_t> &bin = bins_[i][tile];
+    const boost::uint8_t label = instances[i].label;
+
+    for (std::size_t t = 0; t < bin.size(); ++t){
+
+      const ScreenTriangle &tri = triangles_[i][bin[t]];
+      const float *x = tri.x, *y = tri.y, *inverse_depth = tri.inverse_depth;
+      const ci::Vec3f *normal = tri.normal;
+
+      const float inverse_area = 1.0f / EdgeFunction(x[0], y[0], x[1], y[1], x[2], y[2]);
+      const bool owns[3] = { OwnsEdge(x[1], y[1], x[2], y[2]), OwnsEdge(x[2], y[2], x[0], y[0]), OwnsEdge(x[0], y[0], x[1], y[1]) };
+
+      const int min_x = std::max(tri.min_x, tile_min_x), max_x = std::min(tri.max_x, tile_max_x);
+      const int min_y = std::max(tri.min_y, tile_min_y), max_y = std::min(tri.max_y, tile_max_y);
+
+      for (int py = min_y; py <= max_y; ++py){
+
+        const float sample_y = py + 0.5f;
+        boost::uint8_t *label_row = labels.ptr<boost::uint8_t>(py);
+        float *depth_row = &inverse_depth_[py * width];
+        ci::Vec3f *normal_row = normals ? normals->ptr<ci::Vec3f>(py) : 0;
+
+        for (int px = min_x; px <= max_x; ++px){
+
+          const float sample_x = px + 0.5f;
+
+          //each weight is the edge function of the edge opposite that corner
+          const float w0 = EdgeFunction(x[1], y[1], x[2], y[2], sample_x, sample_y);
+          const float w1 = EdgeFunction(x[2], y[2], x[0], y[0], sample_x, sample_y);
+          const float w2 = EdgeFunction(x[0], y[0], x[1], y[1], sample_x, sample_y);
+
+          if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+          if ((w0 == 0 && !owns[0]) || (w1 == 0 && !owns[1]) || (w2 == 0 && !owns[2])) continue;
+
+          const float depth = (w0 * inverse_depth[0] + w1 * inverse_depth[1] + w2 * inverse_depth[2]) * inverse_area;
+          if (depth <= depth_row[px]) continue;
+
+          depth_row[px] = depth;
+          label_row[px] = label;
+
+          //the weights would be divided by the interpolated inverse depth for perspective correction, but that cancels out when normalizing
+          if (normal_row) normal_row[px] = (normal[0] * w0 + normal[1] * w1 + normal[2] * w2).safeNormalized();
+
+        }
+
+      }
+
+    }
+
+  }
+
+  if (!depth) return;
+
+  for (int y = tile_min_y; y <= tile_max_y; ++y){
+    const float *inverse_depth_row = &inverse_depth_[y * width];
+    float *depth_row = depth->ptr<float>(y);
+    for (int x = tile_min_x; x <= tile_max_x; ++x){
+      depth_row[x] = inverse_depth_row[x] > 0 ? 1.0f / inverse_depth_row[x] : 0.0f;
+    }
+  }
+
+}
@@ -0,0 +1,183 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/mask_renderer.hpp"
+#include "../include/frame_writer.hpp"
+#include <boost/scoped_ptr.hpp>
+
+using namespace viz;
+
+namespace {
+
+  const float NEAR_CLIP = 1.0f; /**< The near plane Session sets the cameras up with, so the masks are clipped like the eye views. */
+
+  /**
+  * Turn a camera's distortion map, which holds OpenGL texture coordinates with its rows counted from the bottom (see Camera::SetupDistortionMap()),
+  * into cv::remap() maps for images with their rows counted from the top.
+  * @param[in] distortion_map The camera's distortion map.
+  * @param[out] map_x The pinhole image column for each raw image pixel.
+  * @param[out] map_y The pinhole image row for each raw image pixel.
+  */
+  void RemapFromDistortionMap(const cv::Mat &distortion_map, cv::Mat &map_x, cv::Mat &map_y){
+
+    const int width = distortion_map.cols, height = distortion_map.rows;
+    map_x.create(height, width, CV_32FC1);
+    map_y.create(height, width, CV_32FC1);
+
+    for (int y = 0; y < height; ++y){
+      const cv::Vec2f *map_row = distortion_map.ptr<cv::Vec2f>(height - 1 - y);
+      float *x_row = map_x.ptr<float>(y);
+      float *y_row = map_y.ptr<float>(y);
+      for (int x = 0; x < width; ++x){
+        //the texture coordinates are of pixel centres, so take off half a pixel to get the pixel index remap rounds to
+        x_row[x] = map_row[x][0] * width - 0.5f;
+        y_row[x] = (1.0f - map_row[x][1]) * height - 0.5f;
+      }
+    }
+
+  }
+
+}
+
+MaskRenderer::MaskRenderer(const bool ground_truth) : ground_truth_(ground_truth) {
+
+  headless_ = true;
+
+}
+
+size_t MaskRenderer::Run(const std::string &config_path){
+
+  setupFromConfig(config_path);
+
+  if (!running_) throw std::runtime_error("Error, could not load a session from " + config_path);
+
+  MaskRasterizer left_rasterizer(camera_.GetLeftCamera(), NEAR_CLIP);
+  MaskRasterizer right_rasterizer(camera_.GetRightCamera(), NEAR_CLIP);
+
+  //only the writers for the chosen mode are created, so the other mode's directories aren't made
+  boost::scoped_ptr<FrameSequenceWriter> left_writer, right_writer, left_binary_writer, right_binary_writer;
+  boost::scoped_ptr<GroundTruthWriter> left_ground_truth_writer, right_ground_truth_writer;
+
+  if (ground_truth_){
+    left_ground_truth_writer.reset(new GroundTruthWriter(output_directory_ + "/Left_Ground_Truth", "Left_Ground_Truth"));
+    right_ground_truth_writer.reset(new GroundTruthWriter(output_directory_ + "/Right_Ground_Truth", "Right_Ground_Truth"));
+  }
+  else{
+    left_writer.reset(new FrameSequenceWriter(output_directory_ + "/Left_Mask", "Left_Mask", png_compression_));
+    right_writer.reset(new FrameSequenceWriter(output_directory_ + "/Right_Mask", "Right_Mask", png_compression_));
+    left_binary_writer.reset(new FrameSequenceWriter(output_directory_ + "/Left_Binary_Mask", "Left_Binary_Mask", png_compression_));
+    right_binary_writer.reset(new FrameSequenceWriter(output_directory_ + "/Right_Binary_Mask", "Right_Binary_Mask", png_compression_));
+  }
+
+  //with distort-overlays the masks are warped to line up with the raw frames, like the overlays are
+  const Camera *cameras[2] = { &camera_.GetLeftCamera(), &camera_.GetRightCamera() };
+  for (int eye = 0; eye < 2; ++eye){
+    if (cameras[eye]->GetDistortionMap().empty()){
+      distort_map_x_[eye].release();
+      distort_map_y_[eye].release();
+    }
+    else{
+      RemapFromDistortionMap(cameras[eye]->GetDistortionMap(), distort_map_x_[eye], distort_map_y_[eye]);
+    }
+  }
+
+  const ci::Matrix44f left_to_right = camera_.getLeftToRightTransform();
+
+  cv::Mat labels, depth, normals;
+  size_t frame_count = 0;
+
+  while (loadPoses(true)){
+
+    capturePoses(frame_poses_);
+
+    const ci::Matrix44f world_to_eye[2] = { frame_poses_.camera_pose.inverted(), left_to_right * frame_poses_.camera_pose.inverted() };
+    MaskRasterizer *rasterizers[2] = { &left_rasterizer, &right_rasterizer };
+
+    for (int eye = 0; eye < 2; ++eye){
+
+      if (ground_truth_){
+        drawMask(*rasterizers[eye], world_to_eye[eye], labels, &depth, &normals);
+        distort(eye, labels);
+        distort(eye, depth);
+        distort(eye, normals);
+        (eye == 0 ? left_ground_truth_writer : right_ground_truth_writer)->Write(depth, normals, labels);
+      }
+      else{
+        drawMask(*rasterizers[eye], world_to_eye[eye], labels);
+        distort(eye, labels);
+        (eye == 0 ? left_writer : right_writer)->Write(labels);
+        //255 wherever any part is, so it can be viewed directly
+        (eye == 0 ? left_binary_writer : right_binary_writer)->Write(labels > 0);
+      }
+
+    }
+
+    frame_count++;
+
+  }
+
+  if (left_writer) left_writer->Flush();
+  if (right_writer) right_writer->Flush();
+  if (left_binary_writer) left_binary_writer->Flush();
+  if (right_binary_writer) right_binary_writer->Flush();
+  if (left_ground_truth_writer) left_ground_truth_writer->Flush();
+  if (right_ground_truth_writer) right_ground_truth_writer->Flush();
+
+  running_ = false;
+
+  return frame_count;
+
+}
+
+void MaskRenderer::distort(const int eye, cv::Mat &image) const {
+
+  if (distort_map_x_[eye].empty()) return;
+
+  //nearest neighbour so labels aren't blended, and the background is 0 in all of the images
+  cv::Mat distorted;
+  cv::remap(image, distorted, distort_map_x_[eye], distort_map_y_[eye], cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+  image = distorted;
+
+}
+
+void MaskRenderer::drawMask(MaskRasterizer &rasterizer, const ci::Matrix44f &world_to_eye, cv::Mat &labels, cv::Mat *depth, cv::Mat *normals){
+
+  instances_.clear();
+
+  for (size_t i = 0; i < trackables_.size(); ++i){
+
+    const std::vector< boost::shared_ptr<const ci::TriMesh> > meshes = trackables_[i]->GetModelMeshes();
+    const std::vector<ci::Matrix44f> &transforms = frame_poses_.trackable_transforms[i];
+
+    for (size_t p = 0; p < meshes.size() && p < transforms.size(); ++p){
+
+      MaskRasterizer::Instance instance;
+      instance.mesh = meshes[p];
+      instance.model_to_camera = world_to_eye * transforms[p];
+      instance.label = (boost::uint8_t)(4 * i + p + 1);
+      instances_.push_back(instance);
+
+    }
+
+  }
+
+  rasterizer.Draw(instances_, labels, depth, normals);
+
+}
@@ -0,0 +1,182 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/mesh_cache.hpp"
+#include "../include/file_hash.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+using namespace viz;
+
+namespace {
+
+  const char MESH_CACHE_MAGIC[4] = { 'V', 'M', 'S', 'H' };
+  const boost::uint32_t MESH_CACHE_VERSION = 2;
+
+  struct MeshCacheHeader {
+    char magic[4];
+    boost::uint32_t version;
+    boost::uint64_t source_hash;
+    boost::uint64_t num_vertices;
+    boost::uint64_t num_normals;
+    boost::uint64_t num_tex_coords;
+    boost::uint64_t num_colors;
+    boost::uint64_t num_indices;
+    float error; /**< How far a derived mesh is from the source mesh. */
+    boost::uint32_t padding;
+  };
+
+  template<typename T>
+  const unsigned char *CopyArray(const unsigned char *data, const boost::uint64_t count, std::vector<T> &target){
+    const T *begin = reinterpret_cast<const T *>(data);
+    target.assign(begin, begin + count);
+    return data + count * sizeof(T);
+  }
+
+  template<typename T>
+  void WriteArray(std::ofstream &ofs, const std::vector<T> &source){
+    if (!source.empty()) ofs.write(reinterpret_cast<const char *>(&source[0]), source.size() * sizeof(T));
+  }
+
+}
+
+MeshCache::MeshCache(const std::string &obj_file, const std::string &mtl_file, const boost::uint32_t load_flags, const std::string &variant) : source_hash_(FNV_OFFSET_BASIS) {
+
+  HashFile(obj_file, source_hash_);
+  HashFile(mtl_file, source_hash_);
+  HashBytes(&load_flags, sizeof(load_flags), source_hash_);
+  HashBytes(variant.data(), variant.size(), source_hash_);
+
+  //the fallback is named by the hash so differently loaded copies of the same file don't fight over it
+  cache_paths_ = CachePaths(obj_file, variant + ".vizmesh", "viz-mesh-cache", source_hash_);
+
+}
+
+bool MeshCache::Load(ci::TriMesh &mesh, float &error) const {
+
+  for (std::size_t i = 0; i < cache_paths_.size(); ++i){
+    if (LoadFrom(cache_paths_[i], mesh, error)) return true;
+  }
+
+  return false;
+
+}
+
+void MeshCache::Save(const ci::TriMesh &mesh, const float error) const {
+
+  for (std::size_t i = 0; i < cache_paths_.size(); ++i){
+    if (SaveTo(cache_paths_[i], mesh, error)) return;
+  }
+
+  std::cerr << "Warning, could not write mesh cache for: " << cache_paths_[0] << "\n";
+
+}
+
+bool MeshCache::LoadFrom(const std::string &cache_path, ci::TriMesh &mesh, float &error) const {
+
+  boost::system::error_code ec;
+  const boost::uint64_t file_bytes = boost::filesystem::file_size(cache_path, ec);
+  if (ec || file_bytes < sizeof(MeshCacheHeader)) return false;
+
+  try{
+
+    boost::interprocess::file_mapping mapping(cache_path.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+
+    const unsigned char *data = static_cast<const unsigned char *>(region.get_address());
+    MeshCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (!std::equal(header.magic, header.magic + 4, MESH_CACHE_MAGIC) || header.version != MESH_CACHE_VERSION || header.source_hash != source_hash_) return false;
+
+    const boost::uint64_t expected_bytes = sizeof(MeshCacheHeader) + header.num_vertices * sizeof(ci::Vec3f) + header.num_normals * sizeof(ci::Vec3f) +
+      header.num_tex_coords * sizeof(ci::Vec2f) + header.num_colors * sizeof(ci::Color) + header.num_indices * sizeof(boost::uint32_t);
+    if (expected_bytes != file_bytes) return false;
+
+    mesh.clear();
+    error = header.error;
+    data += sizeof(MeshCacheHeader);
+    data = CopyArray(data, header.num_vertices, mesh.getVertices());
+    data = CopyArray(data, header.num_normals, mesh.getNormals());
+    data = CopyArray(data, header.num_tex_coords, mesh.getTexCoords());
+    data = CopyArray(data, header.num_colors, mesh.getColorsRGB());
+    CopyArray(data, header.num_indices, mesh.getIndices());
+
+  }
+  catch (boost::interprocess::interprocess_exception &){
+    return false;
+  }
+
+  return true;
+
+}
+
+bool MeshCache::SaveTo(const std::string &cache_path, const ci::TriMesh &mesh, const float error) const {
+
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(boost::filesystem::path(cache_path).parent_path(), ec);
+
+  //write to a temporary file and rename it so a half written cache is never picked up
+  const std::string temp_path = cache_path + ".tmp";
+
+  {
+    std::ofstream ofs(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) return false;
+
+    MeshCacheHeader header;
+    std::copy(MESH_CACHE_MAGIC, MESH_CACHE_MAGIC + 4, header.magic);
+    header.version = MESH_CACHE_VERSION;
+    header.source_hash = source_hash_;
+    header.num_vertices = mesh.getVertices().size();
+    header.num_normals = mesh.getNormals().size();
+    header.num_tex_coords = mesh.getTexCoords().size();
+    header.num_colors = mesh.getColorsRGB().size();
+    header.num_indices = mesh.getIndices().size();
+    header.error = error;
+    header.padding = 0;
+
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    WriteArray(ofs, mesh.getVertices());
+    WriteArray(ofs, mesh.getNormals());
+    WriteArray(ofs, mesh.getTexCoords());
+    WriteArray(ofs, mesh.getColorsRGB());
+    WriteArray(ofs, mesh.getIndices());
+
+    if (!ofs) {
+      ofs.close();
+      boost::filesystem::remove(temp_path, ec);
+      return false;
+    }
+  }
+
+  boost::filesystem::rename(temp_path, cache_path, ec);
+  if (ec){
+    boost::filesystem::remove(temp_path, ec);
+    return false;
+  }
+
+  return true;
+
+}
@@ -0,0 +1,367 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/mesh_decimation.hpp"
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+
+using namespace viz;
+
+namespace {
+
+  /**
+  * The sum of squared distances to a set of planes, as a symmetric 4x4 matrix stored as its upper triangle.
+  */
+  struct Quadric {
+
+    Quadric() { std::fill(q, q + 10, 0.0); }
+
+    /**
+    * Add a plane n.p + d = 0, with n a unit normal.
+    */
+    void AddPlane(const ci::Vec3d &n, const double d){
+      q[0] += n.x * n.x; q[1] += n.x * n.y; q[2] += n.x * n.z; q[3] += n.x * d;
+      q[4] += n.y * n.y; q[5] += n.y * n.z; q[6] += n.y * d;
+      q[7] += n.z * n.z; q[8] += n.z * d;
+      q[9] += d * d;
+    }
+
+    void Add(const Quadric &other){
+      for (int i = 0; i < 10; ++i) q[i] += other.q[i];
+    }
+
+    /**
+    * Get the sum of squared distances from a point to the planes.
+    */
+    double Evaluate(const ci::Vec3d &p) const {
+      return q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x
+        + q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y
+        + q[7] * p.z * p.z + 2 * q[8] * p.z
+        + q[9];
+    }
+
+    double q[10];
+
+  };
+
+  /**
+  * A candidate collapse of from onto to. It's out of date if either vertex has changed since it was queued.
+  */
+  struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+    bool operator<(const Collapse &other) const { return cost > other.cost; } //std::priority_queue is a max heap
+  };
+
+  class Decimator {
+
+  public:
+
+    explicit Decimator(const ci::TriMesh &source) : source_(source) {
+
+      const std::vector<ci::Vec3f> &vertices = source.getVertices();
+      const std::vector<uint32_t> &indices = source.getIndices();
+
+      positions_.resize(vertices.size());
+      for (std::size_t i = 0; i < vertices.size(); ++i) positions_[i] = ci::Vec3d(vertices[i].x, vertices[i].y, vertices[i].z);
+
+      triangles_.assign(indices.begin(), indices.end());
+      triangle_removed_.assign(indices.size() / 3, false);
+      num_triangles_ = indices.size() / 3;
+
+      vertex_triangles_.resize(vertices.size());
+      quadrics_.resize(vertices.size());
+      versions_.assign(vertices.size(), 0);
+      removed_.assign(vertices.size(), false);
+
+      for (uint32_t t = 0; t < num_triangles_; ++t){
+
+        for (int c = 0; c < 3; ++c) vertex_triangles_[triangles_[3 * t + c]].push_back(t);
+
+        ci::Vec3d normal;
+        if (!TriangleNormal(t, normal)) continue;
+        const double d = -normal.dot(positions_[triangles_[3 * t]]);
+        for (int c = 0; c < 3; ++c) quadrics_[triangles_[3 * t + c]].AddPlane(normal, d);
+
+      }
+
+      AddBoundaryPlanes();
+
+      for (uint32_t v = 0; v < positions_.size(); ++v) QueueCollapses(v);
+
+    }
+
+    /**
+    * Collapse edges, cheapest first, until there are few enough triangles or nothing left to collapse.
+    * @return The largest error of any collapse.
+    */
+    double Run(const std::size_t target_triangles){
+
+      double max_error = 0;
+
+      while (num_triangles_ > target_triangles && !queue_.empty()){
+
+        const Collapse c = queue_.top();
+        queue_.pop();
+
+        if (removed_[c.from] || removed_[c.to] || versions_[c.from] != c.from_version || versions_[c.to] != c.to_version) continue;
+        if (!CanCollapse(c.from, c.to)) continue;
+
+        ApplyCollapse(c.from, c.to);
+        max_error = std::max(max_error, std::sqrt(std::max(c.cost, 0.0)));
+
+      }
+
+      return max_error;
+
+    }
+
+    /**
+    * Copy the remaining triangles and the vertices they use into a new mesh.
+    */
+    void Extract(ci::TriMesh &decimated) const {
+
+      decimated.clear();
+
+      const std::size_t num_vertices = source_.getNumVertices();
+      const bool has_normals = source_.getNormals().size() == num_vertices;
+      const bool has_tex_coords = source_.getTexCoords().size() == num_vertices;
+      const bool has_colors = source_.getColorsRGB().size() == num_vertices;
+
+      std::vector<uint32_t> new_index(num_vertices, NOT_USED);
+
+      for (uint32_t t = 0; t < triangle_removed_.size(); ++t){
+
+        if (triangle_removed_[t]) continue;
+
+        uint32_t corners[3];
+        for (int c = 0; c < 3; ++c){
+          const uint32_t v = triangles_[3 * t + c];
+          if (new_index[v] == NOT_USED){
+            new_index[v] = (uint32_t)decimated.getNumVertices();
+            decimated.appendVertex(source_.getVertices()[v]);
+            if (has_normals) decimated.appendNormal(source_.getNormals()[v]);
+            if (has_tex_coords) decimated.appendTexCoord(source_.getTexCoords()[v]);
+            if (has_colors) decimated.appendColorRgb(source_.getColorsRGB()[v]);
+          }
+          corners[c] = new_index[v];
+        }
+
+        decimated.appendTriangle(corners[0], corners[1], corners[2]);
+
+      }
+
+    }
+
+  protected:
+
+    static const uint32_t NOT_USED = 0xffffffff;
+
+    bool TriangleNormal(const uint32_t t, ci::Vec3d &normal) const {
+      const ci::Vec3d &a = positions_[triangles_[3 * t]], &b = positions_[triangles_[3 * t + 1]], &c = positions_[triangles_[3 * t + 2]];
+      normal = (b - a).cross(c - a);
+      const double length = normal.length();
+      if (length <= 0) return false;
+      normal /= length;
+      return true;
+    }
+
+    bool HasCorner(const uint32_t t, const uint32_t v) const {
+      return triangles_[3 * t] == v || triangles_[3 * t + 1] == v || triangles_[3 * t + 2] == v;
+    }
+
+    /**
+    * Hold the open edges in place with a plane through each one, perpendicular to its triangle. Moving a vertex along the edge costs nothing but moving
+    * it off the edge does.
+    */
+    void AddBoundaryPlanes(){
+
+      for (uint32_t t = 0; t < num_triangles_; ++t){
+
+        ci::Vec3d normal;
+        if (!TriangleNormal(t, normal)) continue;
+
+        for (int c = 0; c < 3; ++c){
+
+          const uint32_t a = triangles_[3 * t + c], b = triangles_[3 * t + (c + 1) % 3];
+
+          std::size_t edge_count = 0;
+          for (std::size_t i = 0; i < vertex_triangles_[a].size(); ++i){
+            if (HasCorner(vertex_triangles_[a][i], b)) edge_count++;
+          }
+          if (edge_count != 1) continue;
+
+          ci::Vec3d edge_normal = (positions_[b] - positions_[a]).cross(normal);
+          const double length = edge_normal.length();
+          if (length <= 0) continue;
+          edge_normal /= length;
+
+          const double d = -edge_normal.dot(positions_[a]);
+          quadrics_[a].AddPlane(edge_normal, d);
+          quadrics_[b].AddPlane(edge_normal, d);
+
+        }
+
+      }
+
+    }
+
+    /**
+    * Get the vertices which share a triangle with a vertex.
+    */
+    void Neighbours(const uint32_t v, std::vector<uint32_t> &neighbours) const {
+
+      neighbours.clear();
+      for (std::size_t i = 0; i < vertex_triangles_[v].size(); ++i){
+        const uint32_t t = vertex_triangles_[v][i];
+        if (triangle_removed_[t]) continue;
+        for (int c = 0; c < 3; ++c){
+          if (triangles_[3 * t + c] != v) neighbours.push_back(triangles_[3 * t + c]);
+        }
+      }
+
+      std::sort(neighbours.begin(), neighbours.end());
+      neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+    }
+
+    void QueueCollapses(const uint32_t v){
+
+      std::vector<uint32_t> neighbours;
+      Neighbours(v, neighbours);
+
+      for (std::size_t i = 0; i < neighbours.size(); ++i){
+        const uint32_t n = neighbours[i];
+        Quadric q = quadrics_[v];
+        q.Add(quadrics_[n]);
+        Collapse onto_neighbour = { q.Evaluate(positions_[n]), v, n, versions_[v], versions_[n] };
+        Collapse onto_this = { q.Evaluate(positions_[v]), n, v, versions_[n], versions_[v] };
+        queue_.push(onto_neighbour);
+        queue_.push(onto_this);
+      }
+
+    }
+
+    /**
+    * Check that moving from onto to keeps the mesh manifold and doesn't flip any of the triangles around from.
+    */
+    bool CanCollapse(const uint32_t from, const uint32_t to) const {
+
+      //link condition, the only vertices the ends share should be the far corners of the triangles on the edge
+      std::vector<uint32_t> from_neighbours, to_neighbours, shared;
+      Neighbours(from, from_neighbours);
+      Neighbours(to, to_neighbours);
+      std::set_intersection(from_neighbours.begin(), from_neighbours.end(), to_neighbours.begin(), to_neighbours.end(), std::back_inserter(shared));
+
+      std::size_t edge_triangles = 0;
+      for (std::size_t i = 0; i < vertex_triangles_[from].size(); ++i){
+
+        const uint32_t t = vertex_triangles_[from][i];
+        if (triangle_removed_[t]) continue;
+
+        if (HasCorner(t, to)){
+          edge_triangles++;
+          continue;
+        }
+
+        //the triangles which survive the collapse mustn't flip or fold over
+        ci::Vec3d before, after;
+        if (!TriangleNormal(t, before)) continue;
+
+        ci::Vec3d corners[3];
+        for (int c = 0; c < 3; ++c){
+          const uint32_t v = triangles_[3 * t + c];
+          corners[c] = positions_[v == from ? to : v];
+        }
+        after = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+        const double length = after.length();
+        if (length <= 0 || before.dot(after / length) < MIN_NORMAL_COSINE) return false;
+
+      }
+
+      return edge_triangles > 0 && shared.size() == edge_triangles;
+
+    }
+
+    void ApplyCollapse(const uint32_t from, const uint32_t to){
+
+      for (std::size_t i = 0; i < vertex_triangles_[from].size(); ++i){
+
+        const uint32_t t = vertex_triangles_[from][i];
+        if (triangle_removed_[t]) continue;
+
+        if (HasCorner(t, to)){
+          triangle_removed_[t] = true;
+          num_triangles_--;
+          continue;
+        }
+
+        for (int c = 0; c < 3; ++c){
+          if (triangles_[3 * t + c] == from) triangles_[3 * t + c] = to;
+        }
+        vertex_triangles_[to].push_back(t);
+
+      }
+
+      vertex_triangles_[from].clear();
+      removed_[from] = true;
+
+      //drop the removed triangles from the surviving vertex so its list doesn't keep growing
+      std::vector<uint32_t> &to_triangles = vertex_triangles_[to];
+      to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(), [this](const uint32_t t){ return triangle_removed_[t]; }), to_triangles.end());
+
+      quadrics_[to].Add(quadrics_[from]);
+      versions_[to]++;
+      QueueCollapses(to);
+
+    }
+
+    static const double MIN_NORMAL_COSINE;
+
+    const ci::TriMesh &source_;
+    std::vector<ci::Vec3d> positions_;
+    std::vector<uint32_t> triangles_;
+    std::vector<bool> triangle_removed_;
+    std::size_t num_triangles_;
+    std::vector< std::vector<uint32_t> > vertex_triangles_;
+    std::vector<Quadric> quadrics_;
+    std::vector<uint32_t> versions_;
+    std::vector<bool> removed_;
+    std::priority_queue<Collapse> queue_;
+
+  };
+
+  const double Decimator::MIN_NORMAL_COSINE = 0.2;
+
+}
+
+float viz::DecimateMesh(const ci::TriMesh &source, const std::size_t target_triangles, ci::TriMesh &decimated){
+
+  Decimator decimator(source);
+  const double error = decimator.Run(target_triangles);
+  decimator.Extract(decimated);
+  return (float)error;
+
+}
@@ -21,11 +21,113 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <boost/filesystem.hpp>
 #include <cinder/ImageIo.h>
 #include <cinder/app/App.h>
+#include <cinder/gl/GlslProg.h>
+#include <sstream>
+#include <algorithm>
 
 #include "../include/model.hpp"
+#include "../include/stereo_pass.hpp"
+#include "../include/core_renderer.hpp"
+#include "../include/level_of_detail.hpp"
+#include "../include/shader_snippets.hpp"
 
 using namespace viz;
 
+namespace {
+
+  //the phong shader from resources with the model transform chosen per vertex from the part it belongs to, these follow StereoPass::ShaderPrologue()
+  const char *PACKED_VERTEX_SHADER =
+    "uniform mat4 part_transforms[4];\n"
+    "varying vec3 v;\n"
+    "varying vec3 N;\n"
+    "varying vec4 part_weights;\n"
+    "void main()\n"
+    "{\n"
+    "  int part = int(dot(gl_Color, vec4(0.0, 1.0, 2.0, 3.0)) + 0.5);\n"
+    "  vec4 vertex = gl_ModelViewMatrix * (part_transforms[part] * gl_Vertex);\n"
+    "  vec3 normal = gl_NormalMatrix * (part_transforms[part] * vec4(gl_Normal, 0.0)).xyz;\n"
+    "  gl_Position = projectToEye(vertex, normal);\n"
+    "  v = vertex.xyz;\n"
+    "  N = normalize(normal);\n"
+    "  part_weights = gl_Color;\n"
+    "  gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "}\n";
+
+  //each part has its own texture, the lighting and the part's texel come from shader_snippets.hpp
+  const char *PACKED_FRAGMENT_SHADER =
+    "varying vec3 v;\n"
+    "varying vec3 N;\n"
+    "varying vec4 part_weights;\n"
+    "void main()\n"
+    "{\n"
+    "  gl_FragColor = phongLighting(v, N, lightPosition()) * partTexel(part_weights, gl_TexCoord[0].st);\n"
+    "}\n";
+
+  /**
+  * Get the shader for packed instruments, compiling it the first time it's needed.
+  * @param[in] stereo Get the version which draws into both eyes of a StereoPass.
+  * @return The shader, or an empty one if it failed to compile.
+  */
+  ci::gl::GlslProg &PackedShader(const bool stereo){
+
+    static ci::gl::GlslProg shaders[2];
+    static bool compiled[2] = { false, false };
+
+    if (!compiled[stereo]){
+      compiled[stereo] = true;
+      try{
+        const std::string vertex = StereoPass::ShaderPrologue(true, stereo) + PACKED_VERTEX_SHADER;
+        const std::string fragment = StereoPass::ShaderPrologue(false, stereo) + PhongLightingSnippet() + PartTextureSnippet() + PACKED_FRAGMENT_SHADER;
+        shaders[stereo] = ci::gl::GlslProg(vertex.c_str(), fragment.c_str());
+      }
+      catch (ci::gl::GlslProgCompileExc &e){
+        std::cerr << "Warning, could not compile the packed instrument shader, drawing parts separately.\n" << e.what() << std::endl;
+      }
+    }
+
+    return shaders[stereo];
+
+  }
+
+  const float MAX_LEVEL_OF_DETAIL_ERROR_PIXELS = 1.0f; /**< Only draw a decimated mesh if it's within this many pixels of the full one. */
+
+  /**
+  * Pack the meshes of an instrument's four parts into one mesh, tagging each vertex with its part in the vertex color.
+  * @param[in] meshes The shaft, head and clasper meshes.
+  * @param[out] packed The packed mesh.
+  * @return False if the parts don't all have normals and texture coordinates.
+  */
+  bool PackMeshes(const ci::TriMesh *meshes[4], ci::TriMesh &packed){
+
+    for (int p = 0; p < 4; ++p){
+
+      const ci::TriMesh &mesh = *meshes[p];
+      if (mesh.getNormals().size() != mesh.getNumVertices() || mesh.getTexCoords().size() != mesh.getNumVertices()) return false;
+
+      ci::ColorA part_color(0, 0, 0, 0);
+      part_color[p] = 1;
+
+      const uint32_t index_offset = (uint32_t)packed.getNumVertices();
+
+      for (size_t i = 0; i < mesh.getNumVertices(); ++i){
+        packed.appendVertex(mesh.getVertices()[i]);
+        packed.appendNormal(mesh.getNormals()[i]);
+        packed.appendTexCoord(mesh.getTexCoords()[i]);
+        packed.appendColorRgba(part_color);
+      }
+
+      for (size_t i = 0; i < mesh.getIndices().size(); i += 3){
+        packed.appendTriangle(index_offset + mesh.getIndices()[i], index_offset + mesh.getIndices()[i + 1], index_offset + mesh.getIndices()[i + 2]);
+      }
+
+    }
+
+    return true;
+
+  }
+
+}
+
 ci::JsonTree BaseModel::OpenFile(const std::string &datafile_path) const {
 
   boost::filesystem::path p(datafile_path);
@@ -56,11 +158,19 @@ ci::JsonTree BaseModel::OpenFile(const std::string &datafile_path) const {
 
 }
 
-void BaseModel::InternalDraw(const RenderData &rd, const float inc) const {
+void BaseModel::InternalDraw(const RenderData &rd, const ci::Matrix44f &transform, const float inc) const {
+
+  //the core renderer takes the model matrix from its per draw uniform buffer, so the matrix stack is left alone
+  if (CoreRenderer *core = CoreRenderer::Current()){
+    rd.texture_.bind();
+    core->Draw(SelectLevelOfDetail(rd, transform), transform);
+    rd.texture_.unbind();
+    return;
+  }
 
   ci::gl::pushModelView();
 
-  ci::Matrix44f f = rd.transform_;
+  ci::Matrix44f f = transform;
   ci::Matrix44f reflection;
   reflection.setToIdentity();
   /*reflection.at(0, 0) *= -1;*/ // only works if loading from SE3 not DH chain
@@ -98,7 +208,7 @@ void BaseModel::InternalDraw(const RenderData &rd, const float inc) const {
   rd.texture_.enableAndBind();
   //glEnable(GL_COLOR_MATERIAL); //cinder uses colors rather than materials which are ignore by lighting unless you do this call.
   
-  ci::gl::draw(rd.vbo_);
+  StereoPass::Draw(SelectLevelOfDetail(rd));
 
   rd.texture_.unbind();
   //glDisable(GL_COLOR_MATERIAL);
@@ -107,7 +217,22 @@ void BaseModel::InternalDraw(const RenderData &rd, const float inc) const {
 
 }
 
-void BaseModel::LoadComponent(const ci::JsonTree &tree, BaseModel::RenderData &target, const std::string &root_dir){
+const ci::gl::VboMesh &BaseModel::SelectLevelOfDetail(const RenderData &rd, const ci::Matrix44f &transform) const {
+
+  if (rd.levels_of_detail_.empty()) return rd.vbo_;
+
+  const float pixels_per_unit = PixelsPerUnit(rd.bounds_, transform);
+
+  const ci::gl::VboMesh *vbo = &rd.vbo_;
+  for (size_t i = 0; i < rd.levels_of_detail_.size() && rd.levels_of_detail_[i]->error * pixels_per_unit <= MAX_LEVEL_OF_DETAIL_ERROR_PIXELS; ++i){
+    vbo = &rd.levels_of_detail_[i]->vbo;
+  }
+
+  return *vbo;
+
+}
+
+AssetCache::Request BaseModel::ComponentFiles(const ci::JsonTree &tree, const std::string &root_dir) const {
 
   boost::filesystem::path obj_file = boost::filesystem::path(root_dir) / boost::filesystem::path(tree["obj-file"].getValue<std::string>());
   if (!boost::filesystem::exists(obj_file)) throw(std::runtime_error("Error, the file doesn't exist!\n"));
@@ -116,18 +241,34 @@ void BaseModel::LoadComponent(const ci::JsonTree &tree, BaseModel::RenderData &t
   if (!boost::filesystem::exists(mat_file)) throw(std::runtime_error("Error, the file doesn't exist!\n"));
 
   boost::filesystem::path tex_file = boost::filesystem::path(root_dir) / boost::filesystem::path(tree["texture"].getValue<std::string>());
-  bool has_texture = false;
   if (!boost::filesystem::exists(tex_file)) throw(std::runtime_error("Error, the file doens't exist!\n"));
-  
-  if (has_texture = boost::filesystem::exists(tex_file)){
-    ci::gl::Texture::Format format;
-    format.enableMipmapping(true);
-    target.texture_ = ci::gl::Texture(ci::loadImage((tex_file.string())), format);
-  }
 
-  ci::ObjLoader loader(ci::loadFile(obj_file.string()), ci::loadFile(mat_file.string()));
-  loader.load(&target.model_, true, has_texture, true);
-  target.vbo_ = ci::gl::VboMesh(target.model_);
+  AssetCache::Request files;
+  files.obj_file = obj_file.string();
+  files.mtl_file = mat_file.string();
+  files.texture_file = tex_file.string();
+  return files;
+
+}
+
+void BaseModel::AssignComponent(const AssetCache::Request &files, RenderData &target) const {
+
+  const AssetCache &cache = AssetCache::Shared();
+
+  boost::shared_ptr<const AssetCache::Mesh> mesh = cache.GetMesh(files);
+  target.model_ = boost::shared_ptr<const ci::TriMesh>(mesh, &mesh->mesh);
+  target.vbo_ = mesh->vbo;
+  target.texture_ = cache.GetTexture(files);
+  target.bounds_ = mesh->bounds;
+  target.levels_of_detail_.assign(mesh->levels_of_detail.begin(), mesh->levels_of_detail.end());
+
+}
+
+void BaseModel::LoadComponent(const ci::JsonTree &tree, BaseModel::RenderData &target, const std::string &root_dir){
+
+  const AssetCache::Request files = ComponentFiles(tree, root_dir);
+  AssetCache::Shared().Load(std::vector<AssetCache::Request>(1, files));
+  AssignComponent(files, target);
 
 }
 
@@ -137,6 +278,13 @@ void Model::Draw() const {
 
 }
 
+void Model::Draw(const std::vector<ci::Matrix44f> &transforms) const {
+
+  assert(transforms.size() == 1);
+  InternalDraw(body_, transforms[0]);
+
+}
+
 void Model::LoadData(const std::string &datafile_path){
 
   ci::JsonTree tree = OpenFile(datafile_path);
@@ -154,6 +302,10 @@ void Model::SetTransformSet(const std::vector<ci::Matrix44f> &transforms){
   body_.transform_ = transforms[0];
 }
 
+std::vector< boost::shared_ptr<const ci::TriMesh> > Model::GetMeshes() const {
+  return std::vector< boost::shared_ptr<const ci::TriMesh> >(1, body_.model_);
+}
+
 void DaVinciInstrument::Draw() const {
 
   InternalDraw(shaft_,0.001);
@@ -163,14 +315,141 @@ void DaVinciInstrument::Draw() const {
 
 }
 
+void DaVinciInstrument::Draw(const std::vector<ci::Matrix44f> &transforms) const {
+
+  assert(transforms.size() == 4);
+
+  if (DrawPacked(transforms)) return;
+
+  InternalDraw(shaft_, transforms[0], 0.001);
+  InternalDraw(head_, transforms[1]);
+  InternalDraw(clasper1_, transforms[2]);
+  InternalDraw(clasper2_, transforms[3]);
+
+}
+
 void DaVinciInstrument::LoadData(const std::string &datafile_path){
   
   ci::JsonTree tree = OpenFile(datafile_path);
+  const std::string root_dir = boost::filesystem::path(datafile_path).parent_path().string();
+
+  //load all the parts together so any which aren't cached yet are decoded in parallel
+  const char *part_names[4] = { "shaft", "head", "clasper1", "clasper2" };
+  RenderData *parts[4] = { &shaft_, &head_, &clasper1_, &clasper2_ };
+
+  std::vector<AssetCache::Request> files;
+  for (int p = 0; p < 4; ++p){
+    files.push_back(ComponentFiles(tree.getChild(part_names[p]), root_dir));
+  }
+
+  AssetCache::Shared().Load(files);
+
+  std::string packed_key = "packed";
+  for (int p = 0; p < 4; ++p){
+    AssignComponent(files[p], *parts[p]);
+    packed_key += "|" + files[p].obj_file + "|" + files[p].mtl_file;
+  }
+
+  PackParts(packed_key);
+
+}
+
+void DaVinciInstrument::PackParts(const std::string &cache_key){
+
+  packed_vbos_.clear();
+  packed_errors_.clear();
+
+  const RenderData *parts[4] = { &shaft_, &head_, &clasper1_, &clasper2_ };
+
+  //the meshes have no vertex buffers if they were loaded without OpenGL, in which case there's nothing to pack them for
+  for (int p = 0; p < 4; ++p){
+    if (!parts[p]->vbo_) return;
+  }
+
+  //a packed level needs that level of every part, the full meshes are level 0
+  size_t num_levels = 1 + shaft_.levels_of_detail_.size();
+  for (int p = 1; p < 4; ++p) num_levels = std::min(num_levels, 1 + parts[p]->levels_of_detail_.size());
+
+  for (size_t level = 0; level < num_levels; ++level){
+
+    const ci::TriMesh *meshes[4];
+    float error = 0;
+    for (int p = 0; p < 4; ++p){
+      meshes[p] = level == 0 ? parts[p]->model_.get() : &parts[p]->levels_of_detail_[level - 1]->mesh;
+      if (level > 0) error = std::max(error, parts[p]->levels_of_detail_[level - 1]->error);
+    }
+
+    //instruments with the same parts share the packed buffers
+    std::stringstream key;
+    key << cache_key << "|" << level;
+    ci::gl::VboMesh vbo = AssetCache::Shared().GetDerivedMesh(key.str());
 
-  LoadComponent(tree.getChild("shaft"), shaft_, boost::filesystem::path(datafile_path).parent_path().string());
-  LoadComponent(tree.getChild("head"), head_, boost::filesystem::path(datafile_path).parent_path().string());
-  LoadComponent(tree.getChild("clasper1"), clasper1_ , boost::filesystem::path(datafile_path).parent_path().string());
-  LoadComponent(tree.getChild("clasper2"), clasper2_, boost::filesystem::path(datafile_path).parent_path().string());
+    if (!vbo){
+      ci::TriMesh packed;
+      if (!PackMeshes(meshes, packed)) return;
+      vbo = ci::gl::VboMesh(packed);
+      AssetCache::Shared().AddDerivedMesh(key.str(), vbo);
+    }
+
+    packed_vbos_.push_back(vbo);
+    packed_errors_.push_back(error);
+
+  }
+
+}
+
+bool DaVinciInstrument::DrawPacked(const std::vector<ci::Matrix44f> &transforms) const {
+
+  //only replace shaded drawing, the fixed function passes still draw each part
+  GLint current_program = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &current_program);
+  if (current_program == 0 || packed_vbos_.empty()) return false;
+
+  //the core renderer's own shader handles packed meshes
+  CoreRenderer *core = CoreRenderer::Current();
+
+  if (!core){
+    const StereoPass *stereo = StereoPass::Current();
+    ci::gl::GlslProg &shader = PackedShader(stereo != 0);
+    if (!shader) return false;
+
+    shader.bind();
+    if (stereo) stereo->SetUniforms(shader);
+    shader.uniform("part_transforms", &transforms[0], 4);
+    shader.uniform("tex0", 0);
+    shader.uniform("tex1", 1);
+    shader.uniform("tex2", 2);
+    shader.uniform("tex3", 3);
+  }
+
+  const RenderData *parts[4] = { &shaft_, &head_, &clasper1_, &clasper2_ };
+  for (int p = 0; p < 4; ++p){
+    parts[p]->texture_.bind(p);
+  }
+
+  //the parts move separately so use the level which suits the closest one
+  float pixels_per_unit = 0;
+  for (int p = 0; p < 4; ++p){
+    pixels_per_unit = std::max(pixels_per_unit, PixelsPerUnit(parts[p]->bounds_, transforms[p]));
+  }
+
+  size_t level = 0;
+  while (level + 1 < packed_vbos_.size() && packed_errors_[level + 1] * pixels_per_unit <= MAX_LEVEL_OF_DETAIL_ERROR_PIXELS){
+    level++;
+  }
+
+  if (core)
+    core->DrawParts(packed_vbos_[level], transforms);
+  else
+    StereoPass::Draw(packed_vbos_[level]);
+
+  for (int p = 0; p < 4; ++p){
+    parts[p]->texture_.unbind(p);
+  }
+
+  if (!core) glUseProgram(current_program);
+
+  return true;
 
 }
 
@@ -188,6 +467,10 @@ void DaVinciInstrument::SetTransformSet(const std::vector<ci::Matrix44f> &transf
 
 }
 
+std::vector< boost::shared_ptr<const ci::TriMesh> > DaVinciInstrument::GetMeshes() const {
+  return std::vector< boost::shared_ptr<const ci::TriMesh> >({ shaft_.model_, head_.model_, clasper1_.model_, clasper2_.model_ });
+}
+
 void DaVinciInstrument::DrawBody() const{
 
 	InternalDraw(shaft_);
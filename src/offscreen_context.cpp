@@ -0,0 +1,46 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <GL/osmesa.h>
+#include <stdexcept>
+
+#include "../include/offscreen_context.hpp"
+
+using namespace viz;
+
+OffscreenContext::OffscreenContext(const int width, const int height) : buffer_(width * height * 4) {
+
+  OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, NULL);
+  if (!context) throw std::runtime_error("Error, could not create an OSMesa context");
+
+  if (!OSMesaMakeCurrent(context, &buffer_[0], GL_UNSIGNED_BYTE, width, height)){
+    OSMesaDestroyContext(context);
+    throw std::runtime_error("Error, could not make the OSMesa context current");
+  }
+
+  context_ = context;
+
+}
+
+OffscreenContext::~OffscreenContext(){
+
+  OSMesaDestroyContext(static_cast<OSMesaContext>(context_));
+
+}
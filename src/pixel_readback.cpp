@@ -0,0 +1,84 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/pixel_readback.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace viz;
+
+PixelReadback::PixelReadback(const int width, const int height, const std::size_t num_buffers) : width_(width), height_(height), next_(0), pending_(0) {
+
+  for (std::size_t i = 0; i < std::max<std::size_t>(num_buffers, 1); ++i){
+    buffers_.push_back(ci::gl::Vbo(GL_PIXEL_PACK_BUFFER));
+    buffers_.back().bufferData(width_ * height_ * 3, 0, GL_STREAM_READ);
+  }
+
+}
+
+bool PixelReadback::Read(ci::gl::Fbo &framebuffer, cv::Mat &frame){
+
+  if (framebuffer.getWidth() != width_ || framebuffer.getHeight() != height_){
+    throw std::runtime_error("Error, the framebuffer is not the size of the readback buffers.");
+  }
+
+  //with a pack buffer bound glReadPixels just queues a copy into it and returns straight away
+  framebuffer.bindFramebuffer();
+  buffers_[next_].bind();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width_, height_, GL_BGR, GL_UNSIGNED_BYTE, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  buffers_[next_].unbind();
+  framebuffer.unbindFramebuffer();
+
+  next_ = (next_ + 1) % buffers_.size();
+  pending_++;
+
+  if (pending_ < buffers_.size()) return false;
+
+  return Finish(frame);
+
+}
+
+bool PixelReadback::Finish(cv::Mat &frame){
+
+  if (pending_ == 0) return false;
+
+  ci::gl::Vbo &buffer = buffers_[(next_ + buffers_.size() - pending_) % buffers_.size()];
+
+  const uint8_t *pixels = buffer.map(GL_READ_ONLY);
+  if (pixels == 0x0){
+    throw std::runtime_error("Error, could not map the readback buffer.");
+  }
+
+  //OpenGL gives the bottom row first so the flip is done while copying out of the buffer
+  frame.create(height_, width_, CV_8UC3);
+  const std::size_t row_size = width_ * 3;
+  for (int r = 0; r < height_; ++r){
+    std::memcpy(frame.ptr(height_ - 1 - r), pixels + r * row_size, row_size);
+  }
+
+  buffer.unmap();
+  pending_--;
+
+  return true;
+
+}
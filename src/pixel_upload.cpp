@@ -0,0 +1,82 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/pixel_upload.hpp"
+#include <cstring>
+#include <stdexcept>
+
+using namespace viz;
+
+void PixelUpload::Upload(const cv::Mat &frame, ci::gl::Texture &texture){
+
+  if (frame.type() != CV_8UC3){
+    throw std::runtime_error("Error, can only upload 8 bit BGR frames.");
+  }
+
+  //only (re)allocate the texture when the frame size changes, otherwise just replace the contents
+  if (!texture || texture.getWidth() != frame.cols || texture.getHeight() != frame.rows){
+    texture = ci::gl::Texture(frame.cols, frame.rows);
+  }
+
+  const std::size_t row_size = frame.cols * frame.elemSize();
+  const std::size_t frame_size = row_size * frame.rows;
+
+  if (buffer_size_ != frame_size){
+    buffers_.clear();
+    for (std::size_t i = 0; i < num_buffers_; ++i){
+      buffers_.push_back(ci::gl::Vbo(GL_PIXEL_UNPACK_BUFFER));
+      buffers_.back().bufferData(frame_size, 0, GL_STREAM_DRAW);
+    }
+    buffer_size_ = frame_size;
+    next_ = 0;
+  }
+
+  ci::gl::Vbo &buffer = buffers_[next_];
+  next_ = (next_ + 1) % buffers_.size();
+
+  //orphan the old storage so the map doesn't wait for an earlier upload from this buffer to finish
+  buffer.bufferData(frame_size, 0, GL_STREAM_DRAW);
+
+  uint8_t *pixels = buffer.map(GL_WRITE_ONLY);
+  if (pixels == 0x0){
+    throw std::runtime_error("Error, could not map the upload buffer.");
+  }
+
+  if (frame.isContinuous()){
+    std::memcpy(pixels, frame.data, frame_size);
+  }
+  else{
+    for (int r = 0; r < frame.rows; ++r){
+      std::memcpy(pixels + r * row_size, frame.ptr(r), row_size);
+    }
+  }
+
+  buffer.unmap();
+
+  //with an unpack buffer bound this just queues the transfer. the frame is uploaded in its BGR order and swizzled by the driver.
+  buffer.bind();
+  texture.bind();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(texture.getTarget(), 0, 0, 0, frame.cols, frame.rows, GL_BGR, GL_UNSIGNED_BYTE, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  texture.unbind();
+  buffer.unbind();
+
+}
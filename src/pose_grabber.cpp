@@ -52,17 +52,77 @@ std::string BasePoseGrabber::WriteSE3ToString(const ci::Matrix44f &mat){
 }
 
 
-BasePoseGrabber::BasePoseGrabber(const std::string &output_dir) : do_draw_(false) , save_dir_(output_dir) {
+BasePoseGrabber::BasePoseGrabber(const std::string &output_dir) : do_draw_(false) , next_frame_(0), save_dir_(output_dir) {
 
   std::stringstream ss;
   ss << "Pose grabber " << grabber_num_id_;
-  param_modifier_ = ci::params::InterfaceGl::create(ci::app::getWindow(), ss.str(), ci::app::toPixels(ci::Vec2i(50, 50)));
-  param_modifier_->hide();  
+  //there is no window to attach the editor to when running headless
+  if (ci::app::App::get()){
+    param_modifier_ = ci::params::InterfaceGl::create(ci::app::getWindow(), ss.str(), ci::app::toPixels(ci::Vec2i(50, 50)));
+    param_modifier_->hide();  
+  }
 
   grabber_num_id_++;
 
 }
 
+BasePoseGrabber::FramePosition BasePoseGrabber::CurrentFramePosition(){
+
+  FramePosition position;
+
+  std::vector<std::ifstream *> streams = PoseStreams();
+  for (size_t i = 0; i < streams.size(); ++i){
+    position.stream_positions.push_back(streams[i]->tellg());
+  }
+
+  //the trajectory can grow by more than one pose a frame, e.g. when poses are refreshed while paused, so it's stored rather than assumed
+  position.history_size = reference_frame_tracks_.size();
+
+  return position;
+
+}
+
+void BasePoseGrabber::RecordFramePosition(const FramePosition &position){
+
+  //the stream positions don't change if we come back to a frame after a seek but the trajectory length can
+  if (next_frame_ < frame_positions_.size()){
+    frame_positions_[next_frame_] = position;
+  }
+  else{
+    frame_positions_.push_back(position);
+  }
+
+  next_frame_++;
+
+}
+
+bool BasePoseGrabber::Seek(const std::size_t frame){
+
+  std::vector<std::ifstream *> streams = PoseStreams();
+
+  //jump to the target if we've seen it before, otherwise jump as far as we've been and read forward from there
+  const std::size_t jump_to = std::min(frame, frame_positions_.size() > 0 ? frame_positions_.size() - 1 : 0);
+  if (frame_positions_.size() > 0 && (frame < next_frame_ || jump_to > next_frame_)){
+    for (size_t i = 0; i < streams.size(); ++i){
+      streams[i]->clear();
+      streams[i]->seekg(frame_positions_[jump_to].stream_positions[i]);
+    }
+    next_frame_ = jump_to;
+
+    //the frames from here on are read again, so cut the trajectory back to where it was before this frame
+    reference_frame_tracks_.resize(std::min(reference_frame_tracks_.size(), frame_positions_[jump_to].history_size));
+  }
+
+  //some grabbers carry on past the end of their file, but they stop advancing
+  while (next_frame_ < frame){
+    const std::size_t previous_frame = next_frame_;
+    if (!LoadPose(true) || next_frame_ == previous_frame) return false;
+  }
+
+  return true;
+
+}
+
 void BasePoseGrabber::convertFromBouguetPose(const ci::Matrix44f &in_pose, ci::Matrix44f &out_pose){
 
   out_pose.setToIdentity();
@@ -117,6 +177,7 @@ bool PoseGrabber::LoadPose(const bool update_as_new){
 
   //load the new pose (if requested).
   if (update_as_new){
+    const FramePosition position = CurrentFramePosition();
     try{
       std::string line;
       int row = 0;
@@ -137,6 +198,7 @@ bool PoseGrabber::LoadPose(const bool update_as_new){
       //update the reference list of old tracks for drawing trajectories
       reference_frame_tracks_.push_back(cached_model_pose_);
       do_draw_ = true;
+      RecordFramePosition(position);
 
     }
     catch (std::ofstream::failure e){
@@ -286,18 +348,18 @@ void DHDaVinciPoseGrabber::SetupOffsets(const std::string &base_offsets, const s
 
   std::stringstream ss;
   
-  param_modifier_->addText("", "label=`Edit the set up joints`");
+  if (param_modifier_) param_modifier_->addText("", "label=`Edit the set up joints`");
 
   ss << base_offsets;
   for (size_t i = 0; i < base_offsets_.size(); ++i){
     ss >> base_offsets_[i];
     std::stringstream ss;
     ss << "SU Joint " << i;
-    param_modifier_->addParam(ss.str(), &(base_offsets_[i]), "min=-10 max=10 step= 0.0001 keyIncr=z keyDecr=Z");
+    if (param_modifier_) param_modifier_->addParam(ss.str(), &(base_offsets_[i]), "min=-10 max=10 step= 0.0001 keyIncr=z keyDecr=Z");
   }
 
-  param_modifier_->addSeparator();
-  param_modifier_->addText("", "label=`Edit the arm joints`");
+  if (param_modifier_) param_modifier_->addSeparator();
+  if (param_modifier_) param_modifier_->addText("", "label=`Edit the arm joints`");
 
   ss.clear();
   ss << arm_offsets;
@@ -305,6 +367,7 @@ void DHDaVinciPoseGrabber::SetupOffsets(const std::string &base_offsets, const s
     ss >> arm_offsets_[i];
     std::stringstream ss;
     ss << "Joint " << i;
+    if (!param_modifier_) continue;
     if (i < 3)
       param_modifier_->addParam(ss.str(), &(arm_offsets_[i]), "min=-10 max=10 step= 0.0001 keyIncr=z keyDecr=Z");
     else
@@ -363,8 +426,10 @@ ci::Matrix44f DHDaVinciPoseGrabber::GetPose(){
 bool DHDaVinciPoseGrabber::LoadPose(const bool update_as_new){
 
   if (update_as_new){
+    const FramePosition position = CurrentFramePosition();
     if (!ReadDHFromFiles(base_joints_, arm_joints_))
       return false;
+    RecordFramePosition(position);
   }
 
   //don't care about the return.
@@ -379,6 +444,15 @@ bool DHDaVinciPoseGrabber::LoadPose(const bool update_as_new){
 
 }
 
+std::vector<std::ifstream *> DHDaVinciPoseGrabber::PoseStreams(){
+
+  std::vector<std::ifstream *> streams;
+  streams.push_back(&base_ifs_);
+  streams.push_back(&arm_ifs_);
+  return streams;
+
+}
+
 bool DHDaVinciPoseGrabber::ReadDHFromFiles(std::vector<double> &psm_base_joints, std::vector<double> &psm_arm_joints){
 
   assert(num_arm_joints_ == psm_arm_joints.size());
@@ -500,35 +574,35 @@ void SE3DaVinciPoseGrabber::SetupOffsets(const std::string &base_offsets, const
   std::stringstream ss;
   std::stringstream ss2;
 
-  param_modifier_->addText("", "label=`Edit the 6 DOF pose joints`");
+  if (param_modifier_) param_modifier_->addText("", "label=`Edit the 6 DOF pose joints`");
 
   ss << base_offsets;
   ss >> x_rotation_offset_;
-  param_modifier_->addParam("X rotation offset", &x_rotation_offset_, "min=-10 max=10 step= 0.01 keyIncr=r keyDecr=R");
+  if (param_modifier_) param_modifier_->addParam("X rotation offset", &x_rotation_offset_, "min=-10 max=10 step= 0.01 keyIncr=r keyDecr=R");
   
 
   ss << base_offsets;
   ss >> y_rotation_offset_;
-  param_modifier_->addParam("Y rotation offset", &y_rotation_offset_, "min=-10 max=10 step= 0.01 keyIncr=p keyDecr=P");
+  if (param_modifier_) param_modifier_->addParam("Y rotation offset", &y_rotation_offset_, "min=-10 max=10 step= 0.01 keyIncr=p keyDecr=P");
 
   ss << base_offsets;
   ss >> z_rotation_offset_;
-  param_modifier_->addParam("Z rotation offset", &z_rotation_offset_, "min=-10 max=10 step= 0.01 keyIncr=y keyDecr=Y");
+  if (param_modifier_) param_modifier_->addParam("Z rotation offset", &z_rotation_offset_, "min=-10 max=10 step= 0.01 keyIncr=y keyDecr=Y");
 
   ss << base_offsets;
   ss >> x_translation_offset_;
-  param_modifier_->addParam("X translation offset", &x_translation_offset_, "min=-10 max=10 step= 0.001 keyIncr=x keyDecr=X");
+  if (param_modifier_) param_modifier_->addParam("X translation offset", &x_translation_offset_, "min=-10 max=10 step= 0.001 keyIncr=x keyDecr=X");
 
   ss << base_offsets;
   ss >> y_translation_offset_;
-  param_modifier_->addParam("Y translation offset", &y_translation_offset_, "min=-10 max=10 step= 0.001 keyIncr=y keyDecr=Y");
+  if (param_modifier_) param_modifier_->addParam("Y translation offset", &y_translation_offset_, "min=-10 max=10 step= 0.001 keyIncr=y keyDecr=Y");
 
   ss << base_offsets;
   ss >> z_translation_offset_;
-  param_modifier_->addParam("Z translation offset", &z_translation_offset_, "min=-10 max=10 step= 0.001 keyIncr=z keyDecr=Z");
+  if (param_modifier_) param_modifier_->addParam("Z translation offset", &z_translation_offset_, "min=-10 max=10 step= 0.001 keyIncr=z keyDecr=Z");
 
-  param_modifier_->addSeparator();
-  param_modifier_->addText("", "label=`Edit the wrist joints`");
+  if (param_modifier_) param_modifier_->addSeparator();
+  if (param_modifier_) param_modifier_->addText("", "label=`Edit the wrist joints`");
 
   ss.clear();
   ss << arm_offsets;
@@ -536,6 +610,7 @@ void SE3DaVinciPoseGrabber::SetupOffsets(const std::string &base_offsets, const
     ss >> wrist_offsets_[i];
     std::stringstream ss2;
     ss2 << "Joint " << i;
+    if (!param_modifier_) continue;
     if (i < 3)
       param_modifier_->addParam(ss2.str(), &(wrist_offsets_[i]), "min=-10 max=10 step= 0.0001 keyIncr=z keyDecr=Z");
     else
@@ -860,6 +935,8 @@ bool SE3DaVinciPoseGrabber::LoadPose(const bool update_as_new){
 
   if (update_as_new){
 
+    const FramePosition position = CurrentFramePosition();
+
     if (rotation_type_ == LoadType::QUATERNION)
       LoadPoseAsQuaternion();
 
@@ -871,6 +948,9 @@ bool SE3DaVinciPoseGrabber::LoadPose(const bool update_as_new){
 
     else
       return false;
+
+    //the loaders catch their own read errors, which leave the stream failed
+    if (ifs_.good()) RecordFramePosition(position);
   }
 
   
@@ -1038,6 +1118,7 @@ bool QuaternionPoseGrabber::LoadPose(const bool update_as_new){
 
   //load the new pose (if requested).
   if (update_as_new){
+    const FramePosition position = CurrentFramePosition();
     try{
       std::string line;
       int row = 0;
@@ -1071,6 +1152,7 @@ bool QuaternionPoseGrabber::LoadPose(const bool update_as_new){
       //update the reference list of old tracks for drawing trajectories
       reference_frame_tracks_.push_back(shaft_pose_);
       do_draw_ = true;
+      RecordFramePosition(position);
 
     }
     catch (std::ofstream::failure e){
@@ -0,0 +1,938 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include <iostream>
+#include <boost/filesystem.hpp>
+
+#include "../include/session.hpp"
+#include "../include/asset_cache.hpp"
+
+using namespace viz;
+using namespace ci;
+
+Session::Session() : running_(false), frame_generation_(0), camera_image_width_(720), camera_image_height_(576), three_dim_viz_width_(576), three_dim_viz_height_(576),
+  reset_viz_port_(true), proxy_preview_(false), save_format_("avi"), png_compression_(1), headless_(false), interactive_(false) {
+
+  state.load_one = false;
+  state.load_all = false;
+
+  state.save_one = false;
+  state.save_all = false;
+
+}
+
+void Session::setupFromConfig(const std::string &path){
+  
+  running_ = false;
+  frame_poses_ = FramePoses();
+
+  //drop the overlays from any earlier config, they hold the previous calibration's maps
+  left_overlay_ = DistortedOverlay();
+  right_overlay_ = DistortedOverlay();
+
+  ConfigReader reader(path);
+
+  std::string root_dir, output_dir, output_dir_this_run;
+  bool single_pass_stereo = false;
+  bool core_renderer = false;
+
+  try{
+    //sanitise
+    if (reader.has_element("root-dir")){
+
+      root_dir = reader.get_element("root-dir");
+      if (!boost::filesystem::is_directory(root_dir))
+        throw std::runtime_error("");
+
+    }
+    else{
+      //raise error
+      throw std::runtime_error("");
+    }
+
+    if (reader.has_element("output-dir")){
+
+      output_dir = reader.get_element("output-dir");
+      if (!boost::filesystem::is_directory(output_dir))
+        boost::filesystem::create_directories(output_dir);
+
+    }
+
+    if (reader.has_element("left-input-video") && reader.has_element("right-input-video")) {
+
+      video_left_ = VideoIO(root_dir + "/" + reader.get_element("left-input-video"));
+      video_right_ = VideoIO(root_dir + "/" + reader.get_element("right-input-video"));
+
+    }
+    else if (reader.has_element("stereo-input-video")){
+
+      stereo_video_ = VideoIO(root_dir + "/" + reader.get_element("stereo-input-video"));
+
+    }
+    else{
+
+      throw std::runtime_error("");
+
+    }
+
+    //batch runs read each frame once at full resolution and the CPU masks don't decode frames at all, so only the app caches or builds proxies
+    const bool interactive = interactive_ && !headless_;
+
+    if (interactive && reader.has_element("frame-cache-mb")){
+
+      std::size_t cache_mb = 0;
+      std::stringstream ss(reader.get_element("frame-cache-mb"));
+      ss >> cache_mb;
+      video_left_.EnableFrameCache(cache_mb << 20);
+      video_right_.EnableFrameCache(cache_mb << 20);
+      stereo_video_.EnableFrameCache(cache_mb << 20);
+
+    }
+
+    if (interactive && reader.has_element("proxy-scale")){
+
+      int proxy_scale = 0;
+      std::stringstream ss(reader.get_element("proxy-scale"));
+      ss >> proxy_scale;
+      video_left_.GenerateProxy(proxy_scale);
+      video_right_.GenerateProxy(proxy_scale);
+      stereo_video_.GenerateProxy(proxy_scale);
+      proxy_preview_ = true;
+
+    }
+
+    if (reader.has_element("camera-config")){
+
+      camera_.Setup(reader.get_element("root-dir") + "/" + reader.get_element("camera-config"), 1, 1000);
+
+      if (reader.has_element("undistort-video") && reader.get_element("undistort-video") == "1"){
+        camera_.SetupUndistortion();
+      }
+      else if (reader.has_element("distort-overlays") && reader.get_element("distort-overlays") == "1"){
+        camera_.SetupDistortionMaps();
+        if (!headless_){
+          left_overlay_.Setup(camera_.GetLeftCamera());
+          right_overlay_.Setup(camera_.GetRightCamera());
+        }
+      }
+
+      single_pass_stereo = reader.has_element("single-pass-stereo") && reader.get_element("single-pass-stereo") == "1";
+      core_renderer = reader.has_element("core-renderer") && reader.get_element("core-renderer") == "1";
+
+    }
+    else{
+
+      throw std::runtime_error("");
+
+    }
+
+    //create new output subdir
+    for (int n = 0;; ++n){
+      std::stringstream ss;
+      ss << reader.get_element("output-dir") << "/output" << n;
+      boost::filesystem::path output_dir(ss.str());
+      if (!boost::filesystem::is_directory(output_dir)){
+        output_dir_this_run = output_dir.string();
+        break;
+      }
+    }
+
+
+    output_directory_ = output_dir_this_run;
+
+    if (reader.has_element("save-format")){
+      save_format_ = reader.get_element("save-format");
+    }
+
+    if (reader.has_element("png-compression")){
+      std::stringstream ss(reader.get_element("png-compression"));
+      ss >> png_compression_;
+    }
+
+    if (reader.has_element("compress-textures")){
+      AssetCache::SetCompressTextures(reader.get_element("compress-textures") == "1");
+    }
+
+    AssetCache::SetHeadless(headless_);
+
+
+    if (reader.has_element("moveable-camera")){
+
+      try{
+
+        moveable_camera_.reset(new PoseGrabber(ConfigReader(root_dir + "/" + reader.get_element("moveable-camera")), output_dir_this_run));
+
+      }
+      catch (std::runtime_error){
+
+        try{
+
+          moveable_camera_.reset(new DHDaVinciPoseGrabber(ConfigReader(root_dir + "/" + reader.get_element("moveable-camera")), output_dir_this_run));
+
+        }
+        catch (std::runtime_error){
+
+        }
+
+      }
+    }
+
+    if (reader.has_element("tracked-camera")){
+
+      try{
+        tracked_camera_.reset(new PoseGrabber(ConfigReader(root_dir + "/" + reader.get_element("tracked-camera")), output_dir_this_run)); //if there is no moveable camera then there won't be a tracked camera
+      }
+      catch (std::runtime_error){
+        tracked_camera_.reset(new QuaternionPoseGrabber(ConfigReader(root_dir + "/" + reader.get_element("tracked-camera")), output_dir_this_run)); //if there is no moveable camera then there won't be a tracked camera
+      }
+    }
+
+    loadTrackables(reader, output_dir_this_run);
+
+  }
+  catch (std::runtime_error){
+
+    camera_image_width_ = 720;
+    camera_image_height_ = 576;
+    if (!headless_) framebuffer_ = gl::Fbo(camera_image_width_, camera_image_height_);
+
+    return;
+  }
+
+  camera_image_width_ = camera_.GetLeftCamera().getImageWidth();
+  camera_image_height_ = camera_.GetLeftCamera().getImageHeight();
+  if (!headless_) framebuffer_ = gl::Fbo(camera_image_width_, camera_image_height_);
+
+  stereo_pass_ = StereoPass();
+  if (single_pass_stereo && !headless_){
+    if (StereoPass::IsSupported())
+      stereo_pass_.Setup(camera_image_width_, camera_image_height_);
+    else
+      std::cerr << "Warning, single pass stereo needs GL_ARB_draw_instanced and GL_EXT_framebuffer_blit, drawing the eyes separately." << std::endl;
+  }
+
+  core_renderer_.Release();
+  if (core_renderer && !headless_){
+    if (CoreRenderer::IsSupported())
+      core_renderer_.Setup();
+    else
+      std::cerr << "Warning, the core renderer needs GL_ARB_uniform_buffer_object and GL_ARB_vertex_array_object, drawing with the fixed function state." << std::endl;
+  }
+  
+  state.load_one = true;
+
+  running_ = true;
+
+}
+
+void Session::advanceFrame(){
+
+  updateProxy();
+
+  updateModels();
+
+  updateVideo();
+
+  capturePoses(frame_poses_);
+
+}
+
+void Session::seekToFrame(const size_t frame){
+
+  bool has_video = true;
+  size_t previous_frame = 0;
+  if (video_left_.IsOpen() && video_right_.IsOpen()){
+    previous_frame = video_left_.NextFrameIndex();
+  }
+  else if (stereo_video_.IsOpen()){
+    previous_frame = stereo_video_.NextFrameIndex();
+  }
+  else{
+    has_video = false;
+  }
+
+  if (!seekStreams(frame)){
+    std::cerr << "Error, could not seek to frame " << frame << std::endl;
+    //the ones which did move would be out of step with the rest, so put everything back
+    if (has_video && !seekStreams(previous_frame)){
+      std::cerr << "Error, could not go back to frame " << previous_frame << ", the video and poses may be out of step." << std::endl;
+    }
+    return;
+  }
+
+  //load the frame we just moved to on the next update
+  state.load_one = true;
+  running_ = true;
+
+}
+
+bool Session::seekStreams(const size_t frame){
+
+  //every stream is seeked even after a failure, so none are left behind where they were
+  bool success = true;
+
+  if (video_left_.IsOpen() && video_right_.IsOpen()){
+    success = video_left_.Seek(frame) && success;
+    success = video_right_.Seek(frame) && success;
+  }
+  else if (stereo_video_.IsOpen()){
+    success = stereo_video_.Seek(frame) && success;
+  }
+
+  if (moveable_camera_) success = moveable_camera_->Seek(frame) && success;
+  if (tracked_camera_) success = tracked_camera_->Seek(frame) && success;
+  for (size_t i = 0; i < trackables_.size(); ++i){
+    success = trackables_[i]->Seek(frame) && success;
+  }
+
+  return success;
+
+}
+
+void Session::updateModels(){
+
+  if (!loadPoses(state.load_one || state.load_all)){
+    running_ = false;
+  }
+
+}
+
+bool Session::loadPoses(const bool load_new){
+
+  if (moveable_camera_){
+    if (!moveable_camera_->LoadPose(load_new)) return false;
+  }
+
+  if (tracked_camera_){
+    if (!tracked_camera_->LoadPose(load_new)) return false;
+  }
+
+  for (size_t i = 0; i < trackables_.size(); ++i){
+    if (!trackables_[i]->LoadPose(load_new)) return false;
+  }
+
+  return true;
+
+}
+
+namespace {
+
+  //copy a trajectory, only appending the new poses in the usual case where it has just grown by a frame
+  void updateHistory(const std::vector<ci::Matrix44f> &history, std::vector<ci::Matrix44f> &copy){
+
+    if (history.size() >= copy.size() && (copy.empty() || history[copy.size() - 1] == copy.back())){
+      copy.insert(copy.end(), history.begin() + copy.size(), history.end());
+    }
+    else{
+      copy = history;
+    }
+
+  }
+
+}
+
+void Session::capturePoses(FramePoses &poses, const bool with_history){
+
+  poses.camera_pose = getCameraPose();
+
+  if (moveable_camera_){
+    poses.moveable_camera_pose = moveable_camera_->GetPose();
+    if (with_history) updateHistory(moveable_camera_->History(), poses.moveable_camera_history);
+  }
+
+  if (tracked_camera_){
+    poses.tracked_camera_pose = tracked_camera_->GetPose();
+    if (with_history) updateHistory(tracked_camera_->History(), poses.tracked_camera_history);
+  }
+
+  poses.trackable_poses.resize(trackables_.size());
+  poses.trackable_transforms.resize(trackables_.size());
+  for (size_t i = 0; i < trackables_.size(); ++i){
+    poses.trackable_poses[i] = trackables_[i]->GetPose(); //update the pose if needed
+    poses.trackable_transforms[i] = trackables_[i]->GetModelTransforms();
+  }
+
+}
+
+bool Session::readFrames(cv::Mat &left_frame, cv::Mat &right_frame){
+
+  if (video_left_.IsOpen() && video_right_.IsOpen()){
+
+    left_frame = video_left_.Read();
+    right_frame = video_right_.Read();
+
+  }
+  else if (stereo_video_.IsOpen()){
+
+    stereo_video_.Read(left_frame, right_frame);
+
+  }
+
+  return !((video_left_.IsOpen() && (!video_left_.CanRead() || !video_right_.CanRead())) || ((stereo_video_.IsOpen() && !stereo_video_.CanRead())));
+
+}
+
+const cv::Mat &Session::prepareFrame(cv::Mat &frame, const Camera &camera, cv::Mat &resize_buffer, cv::Mat &undistort_buffer){
+
+  const cv::Size image_size(camera.getImageWidth(), camera.getImageHeight());
+
+  if (frame.size() == cv::Size(0, 0)){
+    frame = cv::Mat::zeros(image_size, CV_8UC3);
+  }
+
+  //smaller frames from a proxy are uploaded at their own size and draw2D scales them up, unless the distortion has to be removed at the calibrated size
+  if (!camera.CanUndistort()) return frame;
+
+  const cv::Mat &resized = PrepareFrameForUpload(frame, image_size, resize_buffer);
+  return camera.Undistort(resized, undistort_buffer);
+
+}
+
+void Session::updateVideo(){
+
+  if (state.load_one || state.load_all){
+
+    cv::Mat left_frame;
+    cv::Mat right_frame;
+
+    if (!readFrames(left_frame, right_frame)){
+
+      state.load_all = false;
+      state.load_one = false;
+      running_ = false;
+
+    }
+    else{
+
+      left_upload_.Upload(prepareFrame(left_frame, camera_.GetLeftCamera(), left_resize_buffer_, left_undistort_buffer_), left_texture_);
+      right_upload_.Upload(prepareFrame(right_frame, camera_.GetRightCamera(), right_resize_buffer_, right_undistort_buffer_), right_texture_);
+      frame_generation_++;
+
+    }
+
+  }
+
+}
+
+void Session::updateProxy(){
+
+  //always save from the full resolution video
+  const bool use_proxy = proxy_preview_ && !(state.save_all || state.save_one);
+
+  //if a proxy isn't built yet this fails and we try again next frame
+  if (video_left_.IsOpen() && video_right_.IsOpen()){
+
+    //the eyes switch together, so wait until both proxies are ready and go back to full resolution if either fails to switch
+    if (use_proxy && !(video_left_.IsProxyReady() && video_right_.IsProxyReady())) return;
+
+    if (!video_left_.UseProxy(use_proxy) || !video_right_.UseProxy(use_proxy)){
+      video_left_.UseProxy(false);
+      video_right_.UseProxy(false);
+    }
+
+  }
+  else if (stereo_video_.IsOpen()){
+    stereo_video_.UseProxy(use_proxy);
+  }
+
+}
+
+void Session::draw2D(gl::Texture &tex, const int viewport_x){
+  
+  if (!tex) return;
+
+  GLint vp[4];
+  glGetIntegerv(GL_VIEWPORT, vp);
+  glViewport(viewport_x, 0, camera_image_width_, camera_image_height_);
+
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  
+  glLoadIdentity();
+  glOrtho(0, camera_image_width_, 0, camera_image_height_, 0, 1);
+  
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  
+  glDisable(GL_DEPTH_TEST);
+
+  tex.setFlipped(true);
+
+  //the texture may be a proxy frame smaller than the calibrated size
+  gl::draw(tex, ci::Rectf(0.0f, 0.0f, (float)camera_image_width_, (float)camera_image_height_));
+
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopMatrix();
+
+  glViewport(vp[0], vp[1], vp[2], vp[3]);
+}
+
+void Session::drawTrajectories(const std::vector<ci::Matrix44f> &transforms, TrajectoryBuffer &buffer, ci::Color &color){
+
+  gl::color(color);
+
+  buffer.Update(transforms);
+  buffer.Draw();
+
+  gl::pushModelView();
+
+  gl::multModelView(transforms.back());
+  
+  drawCamera(gl::Texture(), gl::Texture());
+
+  gl::popModelView();
+
+  gl::color(1.0, 1.0, 1.0);
+
+  return;
+
+}
+
+void Session::drawImageOnCamera(gl::Texture &image_data, ci::Vec3f &tl, ci::Vec3f &bl, ci::Vec3f &tr, ci::Vec3f &br){
+  
+  ci::gl::SaveTextureBindState saveBindState(image_data.getTarget());
+  ci::gl::BoolState saveEnabledState(image_data.getTarget());
+  ci::gl::ClientBoolState vertexArrayState(GL_VERTEX_ARRAY);
+  ci::gl::ClientBoolState texCoordArrayState(GL_TEXTURE_COORD_ARRAY);
+  image_data.enableAndBind();
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  GLfloat verts[12];
+  glVertexPointer(3, GL_FLOAT, 0, verts);
+  
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  GLfloat texCoords[8];
+  glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+
+  for (int i = 0; i < 3; ++i) { verts[0 * 3 + i] = tl[i]; }
+  for (int i = 0; i < 3; ++i) { verts[1 * 3 + i] = bl[i]; }
+  for (int i = 0; i < 3; ++i) { verts[2 * 3 + i] = tr[i]; }
+  for (int i = 0; i < 3; ++i) { verts[3 * 3 + i] = br[i]; }
+
+  texCoords[0 * 2 + 0] = 0; texCoords[0 * 2 + 1] = 0;
+  texCoords[1 * 2 + 0] = 0; texCoords[1 * 2 + 1] = 1;
+  texCoords[2 * 2 + 0] = 1; texCoords[2 * 2 + 1] = 0;
+  texCoords[3 * 2 + 0] = 1; texCoords[3 * 2 + 1] = 1;
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void Session::drawCamera(gl::Texture &left_image_data, gl::Texture &right_image_data){
+  
+  ci::Vec3f left_cam_center(0, 0, 0);
+  ci::Vec3f left_cam_bottom_left(-5, -5, 20);
+  ci::Vec3f left_cam_bottom_right(5, -5, 20);
+  ci::Vec3f left_cam_top_left(-5, 5, 20);
+  ci::Vec3f left_cam_top_right(5, 5, 20);
+
+  ci::Vec3f left_to_right_translate(11, 0, 0);
+  ci::Vec3f right_cam_center = left_cam_center + left_to_right_translate;
+  ci::Vec3f right_cam_bottom_left = left_cam_bottom_left + left_to_right_translate;
+  ci::Vec3f right_cam_bottom_right = left_cam_bottom_right + left_to_right_translate;
+  ci::Vec3f right_cam_top_left = left_cam_top_left + left_to_right_translate;
+  ci::Vec3f right_cam_top_right = left_cam_top_right + left_to_right_translate;
+ 
+  if (left_image_data && right_image_data){
+    drawImageOnCamera(left_image_data, left_cam_top_left, left_cam_bottom_left, left_cam_top_right, left_cam_bottom_right);
+    drawImageOnCamera(right_image_data, right_cam_top_left, right_cam_bottom_left, right_cam_top_right, right_cam_bottom_right);
+  }
+
+  ci::Vec3f vertex[8];
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, &vertex[0].x);
+
+  vertex[0] = left_cam_center;
+  vertex[1] = left_cam_bottom_left;
+  vertex[2] = left_cam_center;
+  vertex[3] = left_cam_bottom_right;
+  vertex[4] = left_cam_center;
+  vertex[5] = left_cam_top_left;
+  vertex[6] = left_cam_center;
+  vertex[7] = left_cam_top_right;
+
+  glDrawArrays(GL_LINES, 0, 8);
+
+  vertex[0] = right_cam_center;
+  vertex[1] = right_cam_bottom_left;
+  vertex[2] = right_cam_center;
+  vertex[3] = right_cam_bottom_right;
+  vertex[4] = right_cam_center;
+  vertex[5] = right_cam_top_left;
+  vertex[6] = right_cam_center;
+  vertex[7] = right_cam_top_right;
+
+  glDrawArrays(GL_LINES, 0, 8);
+
+  glLineWidth(2.0f);
+  vertex[0] = left_cam_bottom_left;
+  vertex[1] = left_cam_bottom_right;
+  vertex[2] = left_cam_top_right;
+  vertex[3] = left_cam_top_left;
+  glDrawArrays(GL_LINE_LOOP, 0, 4);
+
+  vertex[0] = right_cam_bottom_left;
+  vertex[1] = right_cam_bottom_right;
+  vertex[2] = right_cam_top_right;
+  vertex[3] = right_cam_top_left;
+  glDrawArrays(GL_LINE_LOOP, 0, 4);
+
+  glLineWidth(1.0f);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  
+}
+
+void Session::drawCameraTracker(){
+
+  gl::clear(Color(0.0, 0.0, 0.0));
+
+  if (!running_) return;
+
+  if (!moveable_camera_ || !tracked_camera_) return;
+  if (frame_poses_.moveable_camera_history.size() == 0 || frame_poses_.tracked_camera_history.size() == 0) return;
+  
+  //set up a camera looking at the 'real' camera origin.
+  ci::CameraPersp maya;
+  maya.setEyePoint(frame_poses_.moveable_camera_history.back().getTranslate().xyz() + ci::Vec3f(30, 60, 60));
+  maya.setWorldUp(ci::Vec3f(0, -1, 0));
+  maya.lookAt(frame_poses_.moveable_camera_history.back().getTranslate().xyz());
+
+  gl::pushMatrices();
+  gl::setMatrices(maya);
+  
+  ci::Area viewport = gl::getViewport();
+  gl::setViewport(ci::Area(0, 0, framebuffer_.getWidth(), framebuffer_.getHeight()));
+  
+  drawTrajectories(frame_poses_.moveable_camera_history, moveable_camera_trajectory_, ci::Color(0.0, 1.0, 1.0));
+
+  drawTrajectories(frame_poses_.tracked_camera_history, tracked_camera_trajectory_, ci::Color(0.4, 1.0, 0.2));
+
+  gl::setViewport(viewport);
+
+  gl::popMatrices();
+
+}
+
+void Session::drawScene(gl::Texture &left_image, gl::Texture &right_image){
+  
+  if (!running_) return;
+
+  gl::clear(Color(0.15, 0.15, 0.15));
+
+  if (trackables_.size() == 0 || frame_poses_.trackable_poses.size() != trackables_.size()) return;
+  
+  if (reset_viz_port_){
+
+    ci::Vec3f eye_point = frame_poses_.trackable_poses[0].getTranslate().xyz() + ci::Vec3f(77.7396, -69.9107, -150.47f);
+
+    ci::CameraPersp maya;
+    maya.setEyePoint(eye_point);
+    maya.setOrientation(ci::Quatf(ci::Vec3f(0.977709, -0.0406959, 0.205982), 2.75995));
+    maya_cam_2_.setCurrentCam(maya);
+    reset_viz_port_ = false;
+  
+  }
+
+  gl::pushMatrices();
+  gl::setMatrices(maya_cam_2_.getCamera());
+  
+
+  ci::Area viewport = gl::getViewport();
+  gl::setViewport(ci::Area(0, 0, framebuffer_3d_.getWidth(), framebuffer_3d_.getHeight()));
+
+  if (moveable_camera_){
+
+    gl::pushModelView();
+    gl::multModelView(frame_poses_.moveable_camera_pose);
+    camera_.TurnOnLight();
+    drawCamera(left_image, right_image);
+    gl::popModelView();
+
+  }
+  else{
+    camera_.TurnOnLight();
+    drawCamera(left_image, right_image);
+  }
+  
+
+  if (tracked_camera_){
+
+    gl::pushModelView();
+    gl::multModelView(frame_poses_.tracked_camera_pose);
+    drawCamera(left_image, right_image);
+    gl::popModelView();
+
+  }
+
+  
+  shader_.bind();
+  shader_.uniform("tex0", 0);
+
+  drawTargets();
+
+  shader_.unbind();
+
+  //if (moveable_camera_)
+  camera_.TurnOffLight();
+
+  gl::setViewport(viewport);
+  gl::popMatrices();
+
+
+
+
+}
+
+void Session::savePoses(){
+  
+  ci::Matrix44f camera_pose;
+  camera_pose.setToIdentity();
+
+  //need to use the camera pose, if we have one (i.e. it's not just identity) to set the instrument pose
+  if (moveable_camera_){
+    moveable_camera_->WritePoseToStream();
+    camera_pose = moveable_camera_->GetPose();
+  }
+
+  for (std::size_t i = 0; i < trackables_.size(); ++i){
+    trackables_[i]->WritePoseToStream(camera_pose);
+  }
+
+  if (tracked_camera_){
+    tracked_camera_->WritePoseToStream();
+  }
+
+}
+
+void Session::drawTargets(){
+
+  //the poses are only missing before the first frame is loaded
+  if (frame_poses_.trackable_transforms.size() != trackables_.size()) return;
+
+  for (size_t i = 0; i < trackables_.size(); ++i){
+
+    trackables_[i]->Draw(frame_poses_.trackable_transforms[i]);
+
+  }
+
+}
+
+ci::Matrix44f Session::getCameraPose(){
+
+  if (tracked_camera_){
+    return tracked_camera_->GetPose();
+  }
+  else if (moveable_camera_){
+    return moveable_camera_->GetPose();
+  }
+  else{
+    return ci::Matrix44f(); //return identity
+  }
+
+}
+
+void Session::drawEye(gl::Texture &texture, bool is_left){
+
+  gl::clear(Color(0, 0, 0));
+
+  gl::disableDepthRead();
+
+  draw2D(texture);
+  
+  gl::enableDepthRead();
+  gl::enableDepthWrite();
+
+  //with the raw video the models are drawn undistorted on their own and then warped onto the image
+  DistortedOverlay &overlay = is_left ? left_overlay_ : right_overlay_;
+  if (overlay.IsSetup()) overlay.Begin();
+
+  gl::pushMatrices();
+
+  if (is_left){
+    camera_.setupLeftCamera(maya_cam_, frame_poses_.camera_pose); //do viewport and set camera pose
+  }
+  else{
+    camera_.setupRightCamera(maya_cam_, frame_poses_.camera_pose);
+  }
+
+  if (core_renderer_.IsSetup()){
+
+    //the camera is still set up on the fixed function matrices, so pick them up once for the frame's uniform buffer. the light sits at the camera.
+    GLfloat projection[16], view[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, view);
+
+    core_renderer_.BeginFrame(ci::Matrix44f(projection), ci::Matrix44f(view), ci::Vec3f::zero());
+    drawTargets();
+    core_renderer_.EndFrame();
+
+  }
+  else{
+
+    shader_.bind();
+    shader_.uniform("tex0", 0);
+
+    drawTargets();
+
+    shader_.unbind();
+
+  }
+  
+  gl::popMatrices(); 
+
+  camera_.unsetCameras(); //reset the viewport values
+
+  if (overlay.IsSetup()) overlay.End();
+
+}
+
+void Session::drawEyesSinglePass(){
+
+  stereo_pass_.Begin();
+
+  gl::disableDepthRead();
+
+  draw2D(left_texture_);
+  draw2D(right_texture_, camera_image_width_);
+
+  gl::enableDepthRead();
+  gl::enableDepthWrite();
+
+  gl::pushMatrices();
+
+  camera_.setupLeftCamera(maya_cam_, frame_poses_.camera_pose);
+
+  GLfloat right_projection[16];
+  camera_.makeRightEyeCurrent();
+  glGetFloatv(GL_PROJECTION_MATRIX, right_projection);
+  camera_.makeLeftEyeCurrent();
+
+  //the eye transform is in camera coordinates, OpenGL's eye coordinates have y and z flipped. the light sits at the left camera.
+  const ci::Matrix44f flip = ci::Matrix44f::createScale(ci::Vec3f(1, -1, -1));
+  stereo_pass_.BeginModels(flip * camera_.getLeftToRightTransform() * flip, ci::Matrix44f(right_projection), ci::Vec3f::zero());
+
+  drawTargets();
+
+  stereo_pass_.EndModels();
+
+  gl::popMatrices();
+
+  camera_.unsetCameras();
+
+  stereo_pass_.End();
+
+}
+
+void Session::drawEyeFromStereo(bool is_left){
+
+  stereo_pass_.CopyEye(is_left);
+
+}
+
+void Session::loadTrackables(const ConfigReader &reader, const std::string &output_dir_this_run){
+
+  for (int i = 0;; ++i){
+
+    try{
+
+      std::stringstream s; 
+      s << "trackable-" << i;
+      loadTrackable(reader.get_element("root-dir") + "/" + reader.get_element(s.str()), output_dir_this_run);
+
+    }
+    catch (std::runtime_error){
+      break;
+    }
+
+  }
+
+}
+
+void Session::loadTrackable(const std::string &filepath, const std::string &output_dir){
+
+  ConfigReader reader(filepath);
+
+  try{
+    trackables_.push_back(boost::shared_ptr<BasePoseGrabber>(new DHDaVinciPoseGrabber(reader, output_dir)));
+    return;
+  }
+  catch (std::runtime_error){
+  
+  }
+
+  try{
+    trackables_.push_back(boost::shared_ptr<BasePoseGrabber>(new SE3DaVinciPoseGrabber(reader, output_dir)));
+    return;
+  }
+  catch (std::runtime_error){
+
+  }
+
+  try{
+    trackables_.push_back(boost::shared_ptr<QuaternionPoseGrabber>(new QuaternionPoseGrabber(reader, output_dir)));
+    return;
+  }
+  catch (std::runtime_error){
+
+  }
+  try{
+    trackables_.push_back(boost::shared_ptr<BasePoseGrabber>(new PoseGrabber(reader, output_dir)));
+    return;
+  }
+  catch (std::runtime_error){
+
+  }
+  
+
+
+}
+
+void Session::drawGrid(float size, float step, float plane_position){
+ 
+ // gl::pushModelView();
+  
+  gl::color(Colorf(0.5f, 0.5f, 0.5f));
+
+  float start = -size;
+
+  for (float i = -size; i <= size; i += step){
+    //gl::drawLine(ci::Vec3f(0.0f, i, 0.0f), ci::Vec3f(size, i, 0.0f));
+    //gl::drawLine(ci::Vec3f(i, 0.0f, 0.0f), ci::Vec3f(i, size, 0.0f));
+    gl::drawLine(ci::Vec3f(start, i, plane_position), ci::Vec3f(size, i, plane_position));
+    gl::drawLine(ci::Vec3f(i, start, plane_position), ci::Vec3f(i, size, plane_position));
+  }
+
+  gl::color(1.0, 1.0, 1.0);
+  /*gl::color(1.0, 0.0, 0.0);
+  gl::drawVector(ci::Vec3f(0, 0, 0), ci::Vec3f(5, 0, 0));
+  gl::color(0.0, 1.0, 0.0);
+  gl::drawVector(ci::Vec3f(0, 0, 0), ci::Vec3f(0, 5, 0));
+  gl::color(0.0, 0.0, 1.0);
+  gl::drawVector(ci::Vec3f(0, 0, 0), ci::Vec3f(0, 0, 5));*/
+
+
+  //gl::color(1.0, 1.0, 1.0);
+
+  //gl::popModelView();
+}
+
@@ -0,0 +1,62 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/shader_snippets.hpp"
+
+namespace {
+
+  const char *PHONG_LIGHTING =
+    "vec4 phongLighting(vec3 v, vec3 N, vec3 light_position)\n"
+    "{\n"
+    "  const vec4 ambient = vec4(0.4, 0.4, 0.4, 1);\n"
+    "  const vec4 diffuse = vec4(0.7, 0.7, 0.7, 1);\n"
+    "  const vec4 specular = vec4(0.5, 0.5, 0.5, 1);\n"
+    "  const float shinyness = 10.0;\n"
+    "  vec3 L = normalize(light_position - v);\n"
+    "  vec3 E = normalize(-v);\n"
+    "  vec3 R = normalize(-reflect(L, N));\n"
+    "  vec4 Idiff = clamp(diffuse * max(dot(N, L), 0.0), 0.0, 1.0);\n"
+    "  vec4 Ispec = clamp(specular * pow(max(dot(R, E), 0.0), shinyness), 0.0, 1.0);\n"
+    "  return ambient + Idiff + Ispec;\n"
+    "}\n";
+
+  const char *PART_TEXTURE =
+    "uniform sampler2D tex0;\n"
+    "uniform sampler2D tex1;\n"
+    "uniform sampler2D tex2;\n"
+    "uniform sampler2D tex3;\n"
+    "vec4 partTexel(vec4 part_weights, vec2 st)\n"
+    "{\n"
+    "  return texture2D(tex0, st) * part_weights.x + texture2D(tex1, st) * part_weights.y + texture2D(tex2, st) * part_weights.z + texture2D(tex3, st) * part_weights.w;\n"
+    "}\n";
+
+}
+
+std::string viz::PhongLightingSnippet(){
+
+  return PHONG_LIGHTING;
+
+}
+
+std::string viz::PartTextureSnippet(){
+
+  return PART_TEXTURE;
+
+}
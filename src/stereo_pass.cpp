@@ -0,0 +1,235 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/stereo_pass.hpp"
+#include "../include/shader_snippets.hpp"
+#include <iostream>
+
+using namespace viz;
+
+namespace {
+
+  //without the stereo pass the helpers are just the usual fixed function lookups
+  const char *MONO_VERTEX_PROLOGUE =
+    "#version 120\n"
+    "vec4 projectToEye(inout vec4 eye_vertex, inout vec3 eye_normal)\n"
+    "{\n"
+    "  return gl_ProjectionMatrix * eye_vertex;\n"
+    "}\n";
+
+  const char *MONO_FRAGMENT_PROLOGUE =
+    "#version 120\n"
+    "vec3 lightPosition()\n"
+    "{\n"
+    "  return gl_LightSource[0].position.xyz;\n"
+    "}\n";
+
+  //instance 0 is the left eye and instance 1 the right. the clip vertex holds the distances to the left and right edges of the eye's own view,
+  //which the two clip planes set up by BeginModels() pick out, so nothing spills into the other eye's half.
+  const char *STEREO_VERTEX_PROLOGUE =
+    "#version 120\n"
+    "#extension GL_ARB_draw_instanced : require\n"
+    "uniform mat4 left_to_right;\n"
+    "uniform mat4 right_projection;\n"
+    "varying float eye;\n"
+    "vec4 projectToEye(inout vec4 eye_vertex, inout vec3 eye_normal)\n"
+    "{\n"
+    "  vec4 clip;\n"
+    "  if (gl_InstanceIDARB == 0){\n"
+    "    eye = 0.0;\n"
+    "    clip = gl_ProjectionMatrix * eye_vertex;\n"
+    "  }\n"
+    "  else{\n"
+    "    eye = 1.0;\n"
+    "    eye_vertex = left_to_right * eye_vertex;\n"
+    "    eye_normal = mat3(left_to_right) * eye_normal;\n"
+    "    clip = right_projection * eye_vertex;\n"
+    "  }\n"
+    "  gl_ClipVertex = vec4(clip.w + clip.x, clip.w - clip.x, 0.0, 1.0);\n"
+    "  return vec4(0.5 * clip.x + (eye - 0.5) * clip.w, clip.yzw);\n"
+    "}\n";
+
+  const char *STEREO_FRAGMENT_PROLOGUE =
+    "#version 120\n"
+    "uniform vec3 light_positions[2];\n"
+    "varying float eye;\n"
+    "vec3 lightPosition()\n"
+    "{\n"
+    "  return eye < 0.5 ? light_positions[0] : light_positions[1];\n"
+    "}\n";
+
+  //the phong shader from resources, moved into each eye
+  const char *STEREO_VERTEX_SHADER =
+    "varying vec3 v;\n"
+    "varying vec3 N;\n"
+    "void main()\n"
+    "{\n"
+    "  vec4 vertex = gl_ModelViewMatrix * gl_Vertex;\n"
+    "  vec3 normal = gl_NormalMatrix * gl_Normal;\n"
+    "  gl_Position = projectToEye(vertex, normal);\n"
+    "  v = vertex.xyz;\n"
+    "  N = normalize(normal);\n"
+    "  gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "}\n";
+
+  const char *STEREO_FRAGMENT_SHADER =
+    "uniform sampler2D tex0;\n"
+    "varying vec3 v;\n"
+    "varying vec3 N;\n"
+    "void main()\n"
+    "{\n"
+    "  gl_FragColor = phongLighting(v, N, lightPosition()) * texture2D(tex0, gl_TexCoord[0].st);\n"
+    "}\n";
+
+}
+
+const StereoPass *StereoPass::current_ = 0;
+
+bool StereoPass::IsSupported(){
+
+  return ci::gl::isExtensionAvailable("GL_ARB_draw_instanced") && ci::gl::isExtensionAvailable("GL_EXT_framebuffer_blit");
+
+}
+
+std::string StereoPass::ShaderPrologue(const bool vertex, const bool stereo){
+
+  if (vertex) return stereo ? STEREO_VERTEX_PROLOGUE : MONO_VERTEX_PROLOGUE;
+  return stereo ? STEREO_FRAGMENT_PROLOGUE : MONO_FRAGMENT_PROLOGUE;
+
+}
+
+void StereoPass::Setup(const int eye_width, const int eye_height){
+
+  try{
+    shader_ = ci::gl::GlslProg((ShaderPrologue(true, true) + STEREO_VERTEX_SHADER).c_str(), (ShaderPrologue(false, true) + PhongLightingSnippet() + STEREO_FRAGMENT_SHADER).c_str());
+  }
+  catch (ci::gl::GlslProgCompileExc &e){
+    std::cerr << "Warning, could not compile the stereo shader, drawing the eyes separately.\n" << e.what() << std::endl;
+    return;
+  }
+
+  framebuffer_ = ci::gl::Fbo(2 * eye_width, eye_height);
+
+}
+
+void StereoPass::Begin(){
+
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &previous_framebuffer_);
+
+  framebuffer_.bindFramebuffer();
+  ci::gl::clear(ci::Color(0, 0, 0));
+
+}
+
+void StereoPass::BeginModels(const ci::Matrix44f &left_to_right, const ci::Matrix44f &right_projection, const ci::Vec3f &light_position){
+
+  left_to_right_ = left_to_right;
+  right_projection_ = right_projection;
+  light_positions_[0] = light_position;
+  light_positions_[1] = left_to_right.transformPointAffine(light_position);
+
+  //the shader puts each eye in its half of clip space, so the viewport covers both
+  glGetIntegerv(GL_VIEWPORT, previous_viewport_);
+  glViewport(0, 0, framebuffer_.getWidth(), framebuffer_.getHeight());
+
+  //the planes are given with an identity modelview so they apply to gl_ClipVertex as it is
+  const GLdouble left_edge[4] = { 1, 0, 0, 0 };
+  const GLdouble right_edge[4] = { 0, 1, 0, 0 };
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  glClipPlane(GL_CLIP_PLANE0, left_edge);
+  glClipPlane(GL_CLIP_PLANE1, right_edge);
+  glPopMatrix();
+  glEnable(GL_CLIP_PLANE0);
+  glEnable(GL_CLIP_PLANE1);
+
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program_);
+  shader_.bind();
+  shader_.uniform("tex0", 0);
+  SetUniforms(shader_);
+
+  current_ = this;
+
+}
+
+void StereoPass::EndModels(){
+
+  current_ = 0;
+
+  glUseProgram(previous_program_);
+  glDisable(GL_CLIP_PLANE0);
+  glDisable(GL_CLIP_PLANE1);
+  glViewport(previous_viewport_[0], previous_viewport_[1], previous_viewport_[2], previous_viewport_[3]);
+
+}
+
+void StereoPass::End(){
+
+  //Fbo::unbindFramebuffer() would go back to the window rather than to whatever was bound before
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, previous_framebuffer_);
+
+}
+
+void StereoPass::CopyEye(const bool is_left) const {
+
+  GLint draw_framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &draw_framebuffer);
+
+  const int eye_width = framebuffer_.getWidth() / 2, eye_height = framebuffer_.getHeight();
+  const int x = is_left ? 0 : eye_width;
+
+  glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, framebuffer_.getId());
+  glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, draw_framebuffer);
+  glBlitFramebufferEXT(x, 0, x + eye_width, eye_height, 0, 0, eye_width, eye_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, draw_framebuffer);
+
+}
+
+void StereoPass::SetUniforms(ci::gl::GlslProg &shader) const {
+
+  shader.uniform("left_to_right", left_to_right_);
+  shader.uniform("right_projection", right_projection_);
+  shader.uniform("light_positions", light_positions_, 2);
+
+}
+
+void StereoPass::Draw(const ci::gl::VboMesh &vbo){
+
+  if (!current_){
+    ci::gl::draw(vbo);
+    return;
+  }
+
+  //the same as gl::draw() but with an instance for each eye
+  vbo.enableClientStates();
+  vbo.bindAllData();
+
+  if (vbo.getNumIndices() > 0){
+    glDrawElementsInstancedARB(vbo.getPrimitiveType(), (GLsizei)vbo.getNumIndices(), GL_UNSIGNED_INT, 0, 2);
+  }
+  else{
+    glDrawArraysInstancedARB(vbo.getPrimitiveType(), 0, (GLsizei)vbo.getNumVertices(), 2);
+  }
+
+  ci::gl::VboMesh::unbindBuffers();
+  vbo.disableClientStates();
+
+}
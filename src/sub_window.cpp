@@ -24,6 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 using namespace viz;
 
 std::string SubWindow::output_directory;
+std::string SubWindow::save_format = "avi";
+int SubWindow::png_compression = 1;
 
 void SubWindow::Init(const std::string &name, int start_x, int start_y, int eye_width, int eye_height, bool can_save){
 
@@ -36,8 +38,7 @@ void SubWindow::Init(const std::string &name, int start_x, int start_y, int eye_
   name_ = name; 
   can_save_ = can_save;
 
-  frame_count_ = 0;
-  file_count_ = 0;
+  has_contents_ = false;
 
   window_coords_ = ci::Rectf(start_x, start_y, start_x + draw_width, start_y + draw_height);
   ci::gl::Fbo::Format f;
@@ -48,7 +49,7 @@ void SubWindow::Init(const std::string &name, int start_x, int start_y, int eye_
 
   if (can_save_){
     save_params_ = ci::params::InterfaceGl::create(ci::app::getWindow(), "Save Window", ci::app::toPixels(ci::Vec2i(100, 100)));
-    save_params_->addButton("Save contents to file", std::bind(&SubWindow::InitSavingWindow, this, 0));
+    save_params_->addButton("Save contents to file", std::bind(&SubWindow::InitSavingWindow, this));
     save_params_->show();
   }
 
@@ -73,6 +74,16 @@ void SubWindow::UnBind() {
   framebuffer_->unbindFramebuffer();
 }
 
+bool SubWindow::NeedsRedraw(const boost::uint64_t signature){
+
+  if (has_contents_ && signature == signature_) return false;
+
+  has_contents_ = true;
+  signature_ = signature;
+  return true;
+
+}
+
 bool SubWindow::CanSave() const {
 
   return can_save_; 
@@ -82,26 +93,26 @@ bool SubWindow::CanSave() const {
 
 bool SubWindow::IsSaving() const {
   
-  return writer_.isOpened();
+  return frame_writer_.get() != 0;
 
 }
 
-void SubWindow::WriteFrameToFile(){
+void SubWindow::WriteFrameToFile(const bool wait){
 
-  cv::Mat window = toOcv(framebuffer_->getTexture());
-  
-  cv::Mat flipped_window;
-  cv::flip(window, flipped_window, 0);
-
-  if (frame_count_ == 2000){
-    file_count_++;
-    frame_count_ = 0;
-    CloseStream();
-    InitSavingWindow(file_count_);
+  if (!readback_){
+    readback_.reset(new PixelReadback(framebuffer_->getWidth(), framebuffer_->getHeight()));
+  }
+
+  //this usually finishes the read from a couple of frames ago rather than waiting for this one
+  if (readback_->Read(*framebuffer_, readback_frame_)){
+    frame_writer_->Write(readback_frame_);
+  }
+
+  if (wait){
+    while (readback_->Finish(readback_frame_)){
+      frame_writer_->Write(readback_frame_);
+    }
   }
-    
-  frame_count_++;
-  writer_.write(window);
 
 }
 
@@ -129,8 +140,6 @@ void SubWindow::Draw(){
   
   ci::Rectf window_with_buffer = GetRectWithBuffer();
 
-  cv::Mat m = toOcv(framebuffer_->getTexture());
-
   ci::gl::draw(framebuffer_->getTexture(), window_with_buffer);
 
   if (can_save_){
@@ -142,23 +151,23 @@ void SubWindow::Draw(){
 
 void SubWindow::CloseStream(){
 
-  if (writer_.isOpened())
-    writer_.release();
+  if (readback_){
+    while (readback_->Finish(readback_frame_)){
+      frame_writer_->Write(readback_frame_);
+    }
+    readback_.reset();
+  }
+
+  //closes the video file or waits for the queued frames to be written
+  frame_writer_.reset();
   
 }
 
-void SubWindow::InitSavingWindow(const size_t vid_file_idx){
-
-  std::string &save_dir = output_directory;
-  if (!boost::filesystem::exists(save_dir)) {
-    boost::filesystem::create_directory(save_dir);
-  }
+void SubWindow::InitSavingWindow(){
 
   std::string name = name_;
   std::replace(name.begin(), name.end(), ' ', '_');
-  std::stringstream filepath;
-  filepath << save_dir + "/" + name + "_" << vid_file_idx << ".avi";
 
-  writer_.open(filepath.str(), CV_FOURCC('D', 'I', 'B', ' '), 25, cv::Size(texture_.getWidth(), texture_.getHeight()));
+  frame_writer_ = OpenFrameWriter(save_format, output_directory, name, cv::Size(texture_.getWidth(), texture_.getHeight()), png_compression);
 
 }
\ No newline at end of file
@@ -0,0 +1,360 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/texture_cache.hpp"
+#include "../include/file_hash.hpp"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+using namespace viz;
+
+namespace {
+
+  const char TEXTURE_CACHE_MAGIC[4] = { 'V', 'M', 'I', 'P' };
+  const boost::uint32_t TEXTURE_CACHE_VERSION = 1;
+
+  struct TextureCacheHeader {
+    char magic[4];
+    boost::uint32_t version;
+    boost::uint64_t source_hash;
+    boost::uint32_t format;
+    boost::uint32_t num_levels;
+  };
+
+  struct LevelHeader {
+    boost::int32_t width;
+    boost::int32_t height;
+    boost::uint64_t num_bytes;
+  };
+
+  boost::uint16_t ToRGB565(const int r, const int g, const int b){
+    return (boost::uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+  }
+
+  void FromRGB565(const boost::uint16_t c, int rgb[3]){
+    rgb[0] = ((c >> 11) & 31) * 255 / 31;
+    rgb[1] = ((c >> 5) & 63) * 255 / 63;
+    rgb[2] = (c & 31) * 255 / 31;
+  }
+
+  /**
+  * Compress a 4x4 block of pixels to DXT1. The end points are the corners of the block's color bounding box, pulled in slightly so the
+  * interpolated colors fit the block better.
+  * @param[in] image The BGR image.
+  * @param[in] x The left column of the block.
+  * @param[in] y The top row of the block.
+  * @param[out] block The 8 bytes of the compressed block.
+  */
+  void CompressBlockDXT1(const cv::Mat &image, const int x, const int y, unsigned char *block){
+
+    //blocks which hang off the edge of a small mip level repeat the edge pixels
+    int pixels[16][3];
+    for (int by = 0; by < 4; ++by){
+      const cv::Vec3b *row = image.ptr<cv::Vec3b>(std::min(y + by, image.rows - 1));
+      for (int bx = 0; bx < 4; ++bx){
+        const cv::Vec3b &bgr = row[std::min(x + bx, image.cols - 1)];
+        pixels[4 * by + bx][0] = bgr[2];
+        pixels[4 * by + bx][1] = bgr[1];
+        pixels[4 * by + bx][2] = bgr[0];
+      }
+    }
+
+    int min_color[3] = { 255, 255, 255 }, max_color[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i){
+      for (int c = 0; c < 3; ++c){
+        min_color[c] = std::min(min_color[c], pixels[i][c]);
+        max_color[c] = std::max(max_color[c], pixels[i][c]);
+      }
+    }
+
+    for (int c = 0; c < 3; ++c){
+      const int inset = (max_color[c] - min_color[c]) / 16;
+      min_color[c] += inset;
+      max_color[c] -= inset;
+    }
+
+    boost::uint16_t color0 = ToRGB565(max_color[0], max_color[1], max_color[2]);
+    boost::uint16_t color1 = ToRGB565(min_color[0], min_color[1], min_color[2]);
+    if (color0 < color1) std::swap(color0, color1);
+
+    //color0 > color1 selects the four color mode, if they're equal every pixel just uses color0
+    int palette[4][3];
+    FromRGB565(color0, palette[0]);
+    FromRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c){
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    boost::uint32_t indices = 0;
+    if (color0 != color1){
+      for (int i = 0; i < 16; ++i){
+        int best = 0, best_distance = INT_MAX;
+        for (int p = 0; p < 4; ++p){
+          int distance = 0;
+          for (int c = 0; c < 3; ++c) distance += (pixels[i][c] - palette[p][c]) * (pixels[i][c] - palette[p][c]);
+          if (distance < best_distance){
+            best_distance = distance;
+            best = p;
+          }
+        }
+        indices |= (boost::uint32_t)best << (2 * i);
+      }
+    }
+
+    block[0] = (unsigned char)(color0 & 0xff);
+    block[1] = (unsigned char)(color0 >> 8);
+    block[2] = (unsigned char)(color1 & 0xff);
+    block[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; ++i) block[4 + i] = (unsigned char)((indices >> (8 * i)) & 0xff);
+
+  }
+
+  void CompressDXT1(const cv::Mat &image, std::vector<unsigned char> &data){
+
+    const int blocks_x = (image.cols + 3) / 4, blocks_y = (image.rows + 3) / 4;
+    data.resize(8 * blocks_x * blocks_y);
+
+    for (int by = 0; by < blocks_y; ++by){
+      for (int bx = 0; bx < blocks_x; ++bx){
+        CompressBlockDXT1(image, 4 * bx, 4 * by, &data[8 * (by * blocks_x + bx)]);
+      }
+    }
+
+  }
+
+}
+
+void MipChain::Build(const cv::Mat &image, const bool compress){
+
+  cv::Mat level_image;
+  if (image.depth() == CV_16U) image.convertTo(level_image, CV_8U, 1.0 / 257);
+  else image.convertTo(level_image, CV_8U);
+
+  if (level_image.channels() == 1) cv::cvtColor(level_image, level_image, CV_GRAY2BGR);
+
+  const bool has_alpha = level_image.channels() == 4;
+  format = has_alpha ? BGRA8 : (compress ? DXT1 : BGR8);
+  levels.clear();
+
+  while (true){
+
+    Level level;
+    level.width = level_image.cols;
+    level.height = level_image.rows;
+
+    if (format == DXT1){
+      CompressDXT1(level_image, level.data);
+    }
+    else{
+      if (!level_image.isContinuous()) level_image = level_image.clone();
+      level.data.assign(level_image.data, level_image.data + level_image.total() * level_image.elemSize());
+    }
+
+    levels.push_back(level);
+
+    if (level_image.cols == 1 && level_image.rows == 1) break;
+
+    //halve like glGenerateMipmap does, each pixel averages the 2x2 pixels above it
+    cv::Mat next;
+    cv::resize(level_image, next, cv::Size(std::max(1, level_image.cols / 2), std::max(1, level_image.rows / 2)), 0, 0, cv::INTER_AREA);
+    level_image = next;
+
+  }
+
+}
+
+ci::gl::Texture MipChain::Upload() const {
+
+  if (levels.empty()) return ci::gl::Texture();
+
+  GLuint texture_id = 0;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+
+  GLint unpack_alignment;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  for (std::size_t i = 0; i < levels.size(); ++i){
+
+    const Level &level = levels[i];
+
+    if (format == DXT1){
+      glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, level.width, level.height, 0, (GLsizei)level.data.size(), &level.data[0]);
+    }
+    else if (format == BGRA8){
+      glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width, level.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, &level.data[0]);
+    }
+    else{
+      glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGB8, level.width, level.height, 0, GL_BGR, GL_UNSIGNED_BYTE, &level.data[0]);
+    }
+
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  //the texture takes ownership and deletes the GL texture when the last copy goes
+  return ci::gl::Texture(GL_TEXTURE_2D, texture_id, levels[0].width, levels[0].height, false);
+
+}
+
+TextureCache::TextureCache(const std::string &image_file, const bool compress) : image_file_(image_file), compress_(compress), source_hash_(FNV_OFFSET_BASIS) {
+
+  HashFile(image_file, source_hash_);
+  HashBytes(&compress, sizeof(compress), source_hash_);
+
+  cache_paths_ = CachePaths(image_file, compress ? ".dxt1.vizmip" : ".vizmip", "viz-texture-cache", source_hash_);
+
+}
+
+bool TextureCache::Load(MipChain &chain) const {
+
+  for (std::size_t i = 0; i < cache_paths_.size(); ++i){
+    if (LoadFrom(cache_paths_[i], chain)) return true;
+  }
+
+  const cv::Mat image = cv::imread(image_file_, CV_LOAD_IMAGE_UNCHANGED);
+  if (image.empty()) return false;
+
+  chain.Build(image, compress_);
+
+  for (std::size_t i = 0; i < cache_paths_.size(); ++i){
+    if (SaveTo(cache_paths_[i], chain)) return true;
+  }
+
+  std::cerr << "Warning, could not write texture cache for: " << image_file_ << "\n";
+  return true;
+
+}
+
+bool TextureCache::LoadFrom(const std::string &cache_path, MipChain &chain) const {
+
+  boost::system::error_code ec;
+  const boost::uint64_t file_bytes = boost::filesystem::file_size(cache_path, ec);
+  if (ec || file_bytes < sizeof(TextureCacheHeader)) return false;
+
+  try{
+
+    boost::interprocess::file_mapping mapping(cache_path.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+
+    const unsigned char *data = static_cast<const unsigned char *>(region.get_address());
+    const unsigned char *end = data + file_bytes;
+
+    TextureCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+
+    if (!std::equal(header.magic, header.magic + 4, TEXTURE_CACHE_MAGIC) || header.version != TEXTURE_CACHE_VERSION || header.source_hash != source_hash_) return false;
+    if (header.format > MipChain::DXT1 || header.num_levels == 0) return false;
+
+    chain.format = (MipChain::Format)header.format;
+    chain.levels.resize(header.num_levels);
+
+    for (std::size_t i = 0; i < chain.levels.size(); ++i){
+
+      LevelHeader level_header;
+      if ((std::size_t)(end - data) < sizeof(level_header)) return false;
+      std::memcpy(&level_header, data, sizeof(level_header));
+      data += sizeof(level_header);
+
+      if ((boost::uint64_t)(end - data) < level_header.num_bytes) return false;
+
+      chain.levels[i].width = level_header.width;
+      chain.levels[i].height = level_header.height;
+      chain.levels[i].data.assign(data, data + level_header.num_bytes);
+      data += level_header.num_bytes;
+
+    }
+
+  }
+  catch (boost::interprocess::interprocess_exception &){
+    return false;
+  }
+
+  return true;
+
+}
+
+bool TextureCache::SaveTo(const std::string &cache_path, const MipChain &chain) const {
+
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(boost::filesystem::path(cache_path).parent_path(), ec);
+
+  //write to a temporary file and rename it so a half written cache is never picked up
+  const std::string temp_path = cache_path + ".tmp";
+
+  {
+    std::ofstream ofs(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) return false;
+
+    TextureCacheHeader header;
+    std::copy(TEXTURE_CACHE_MAGIC, TEXTURE_CACHE_MAGIC + 4, header.magic);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.source_hash = source_hash_;
+    header.format = chain.format;
+    header.num_levels = (boost::uint32_t)chain.levels.size();
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (std::size_t i = 0; i < chain.levels.size(); ++i){
+      LevelHeader level_header;
+      level_header.width = chain.levels[i].width;
+      level_header.height = chain.levels[i].height;
+      level_header.num_bytes = chain.levels[i].data.size();
+      ofs.write(reinterpret_cast<const char *>(&level_header), sizeof(level_header));
+      ofs.write(reinterpret_cast<const char *>(&chain.levels[i].data[0]), chain.levels[i].data.size());
+    }
+
+    if (!ofs) {
+      ofs.close();
+      boost::filesystem::remove(temp_path, ec);
+      return false;
+    }
+  }
+
+  boost::filesystem::rename(temp_path, cache_path, ec);
+  if (ec){
+    boost::filesystem::remove(temp_path, ec);
+    return false;
+  }
+
+  return true;
+
+}
@@ -0,0 +1,225 @@
+/**
+
+viz - A robotics visualizer specialized for the da Vinci robotic system.
+Copyright (C) 2014 Max Allan
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+**/
+
+#include "../include/trajectory_buffer.hpp"
+#include "../include/level_of_detail.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace viz;
+
+namespace {
+
+  const std::size_t CHUNK_SIZE = 256; /**< The number of segments simplified at a time. */
+  const float FINEST_TOLERANCE = 0.02f; /**< The tolerance of the first simplified level, in world units. */
+  const float TOLERANCE_STEP = 4.0f; /**< How much coarser each level is than the last. */
+  const std::size_t NUM_SIMPLIFIED_LEVELS = 6; /**< The number of levels as well as the full path. */
+
+  /**
+  * Get the distance from a point to a line segment.
+  */
+  float DistanceToSegment(const ci::Vec3f &point, const ci::Vec3f &start, const ci::Vec3f &end){
+
+    const ci::Vec3f segment = end - start;
+    const float length_squared = segment.lengthSquared();
+    if (length_squared == 0.0f) return point.distance(start);
+
+    const float t = std::min(1.0f, std::max(0.0f, (point - start).dot(segment) / length_squared));
+    return point.distance(start + segment * t);
+
+  }
+
+  /**
+  * Simplify a polyline with Douglas-Peucker. The first and last points are always kept.
+  * @param[in] points The polyline.
+  * @param[in] num_points The number of points in the polyline.
+  * @param[in] tolerance The furthest a removed point can be from the simplified polyline.
+  * @param[out] simplified The points which are kept are appended to this.
+  */
+  void SimplifyPolyline(const ci::Vec3f *points, const std::size_t num_points, const float tolerance, std::vector<ci::Vec3f> &simplified){
+
+    std::vector<bool> keep(num_points, false);
+    keep.front() = keep.back() = true;
+
+    std::vector< std::pair<std::size_t, std::size_t> > spans(1, std::make_pair(std::size_t(0), num_points - 1));
+
+    while (!spans.empty()){
+
+      const std::size_t start = spans.back().first, end = spans.back().second;
+      spans.pop_back();
+
+      float furthest_distance = 0.0f;
+      std::size_t furthest = start;
+      for (std::size_t i = start + 1; i < end; ++i){
+        const float distance = DistanceToSegment(points[i], points[start], points[end]);
+        if (distance > furthest_distance){
+          furthest_distance = distance;
+          furthest = i;
+        }
+      }
+
+      if (furthest_distance > tolerance){
+        keep[furthest] = true;
+        spans.push_back(std::make_pair(start, furthest));
+        spans.push_back(std::make_pair(furthest, end));
+      }
+
+    }
+
+    for (std::size_t i = 0; i < num_points; ++i){
+      if (keep[i]) simplified.push_back(points[i]);
+    }
+
+  }
+
+}
+
+TrajectoryBuffer::TrajectoryBuffer() : num_chunks_(0) {
+
+  levels_.resize(NUM_SIMPLIFIED_LEVELS + 1);
+
+  float tolerance = FINEST_TOLERANCE;
+  levels_[0].tolerance = 0.0f;
+  for (std::size_t i = 1; i < levels_.size(); ++i){
+    levels_[i].tolerance = tolerance;
+    tolerance *= TOLERANCE_STEP;
+  }
+
+  for (std::size_t i = 0; i < levels_.size(); ++i){
+    levels_[i].capacity = 0;
+  }
+
+  Clear();
+
+}
+
+void TrajectoryBuffer::Clear(){
+
+  for (std::size_t i = 0; i < levels_.size(); ++i){
+    levels_[i].points.clear();
+    levels_[i].num_uploaded = 0;
+  }
+
+  num_chunks_ = 0;
+  bounds_min_ = ci::Vec3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+  bounds_max_ = -bounds_min_;
+
+}
+
+void TrajectoryBuffer::Update(const std::vector<ci::Matrix44f> &transforms){
+
+  std::vector<ci::Vec3f> &full_path = levels_[0].points;
+
+  //anything other than new poses on the end means starting again
+  if (transforms.size() < full_path.size() || (!full_path.empty() && transforms[full_path.size() - 1].getTranslate().xyz() != full_path.back())){
+    Clear();
+  }
+
+  for (std::size_t i = full_path.size(); i < transforms.size(); ++i){
+    const ci::Vec3f point = transforms[i].getTranslate().xyz();
+    full_path.push_back(point);
+    bounds_min_ = ci::Vec3f(std::min(bounds_min_.x, point.x), std::min(bounds_min_.y, point.y), std::min(bounds_min_.z, point.z));
+    bounds_max_ = ci::Vec3f(std::max(bounds_max_.x, point.x), std::max(bounds_max_.y, point.y), std::max(bounds_max_.z, point.z));
+  }
+
+  //a chunk is finished once the point after it exists, chunks share their end points so the levels stay joined up
+  while ((num_chunks_ + 1) * CHUNK_SIZE < full_path.size()){
+    SimplifyNextChunk();
+  }
+
+}
+
+void TrajectoryBuffer::SimplifyNextChunk(){
+
+  const ci::Vec3f *chunk = &levels_[0].points[num_chunks_ * CHUNK_SIZE];
+
+  for (std::size_t i = 1; i < levels_.size(); ++i){
+
+    std::vector<ci::Vec3f> &points = levels_[i].points;
+
+    //don't repeat the point shared with the previous chunk
+    if (!points.empty()) points.pop_back();
+    SimplifyPolyline(chunk, CHUNK_SIZE + 1, levels_[i].tolerance, points);
+
+  }
+
+  num_chunks_++;
+
+}
+
+void TrajectoryBuffer::Upload(Level &level){
+
+  if (level.num_uploaded == level.points.size()) return;
+
+  if (level.points.size() > level.capacity){
+
+    //double the size each time so the whole level is only uploaded again a handful of times
+    level.capacity = std::max<std::size_t>(1024, level.capacity * 2);
+    while (level.capacity < level.points.size()) level.capacity *= 2;
+
+    level.vbo = ci::gl::Vbo(GL_ARRAY_BUFFER);
+    level.vbo.bufferData(level.capacity * sizeof(ci::Vec3f), 0, GL_DYNAMIC_DRAW);
+    level.num_uploaded = 0;
+
+  }
+
+  level.vbo.bufferSubData(level.num_uploaded * sizeof(ci::Vec3f), (level.points.size() - level.num_uploaded) * sizeof(ci::Vec3f), &level.points[level.num_uploaded]);
+  level.num_uploaded = level.points.size();
+
+}
+
+void TrajectoryBuffer::Draw(const float max_error_pixels){
+
+  const Level &full_path = levels_[0];
+  if (full_path.points.size() < 2) return;
+
+  const float pixels_per_unit = PixelsPerUnit(ci::Sphere((bounds_min_ + bounds_max_) * 0.5f, 0.5f * bounds_min_.distance(bounds_max_)));
+
+  std::size_t level = 0;
+  while (level + 1 < levels_.size() && levels_[level + 1].tolerance * pixels_per_unit <= max_error_pixels){
+    level++;
+  }
+
+  //the simplified levels only cover the finished chunks, the rest is drawn from the full path
+  const std::size_t tail_start = level == 0 ? 0 : num_chunks_ * CHUNK_SIZE;
+
+  if (level > 0 && levels_[level].points.size() > 1){
+    Upload(levels_[level]);
+    DrawStrip(levels_[level], 0, levels_[level].points.size());
+  }
+
+  Upload(levels_[0]);
+  DrawStrip(levels_[0], tail_start, full_path.points.size() - tail_start);
+
+}
+
+void TrajectoryBuffer::DrawStrip(Level &level, const std::size_t first, const std::size_t count){
+
+  if (count < 2) return;
+
+  ci::gl::ClientBoolState vertex_array_state(GL_VERTEX_ARRAY);
+
+  level.vbo.bind();
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, sizeof(ci::Vec3f), 0);
+  glDrawArrays(GL_LINE_STRIP, (GLint)first, (GLsizei)count);
+  level.vbo.unbind();
+
+}
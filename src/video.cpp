@@ -22,11 +22,103 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <opencv2/highgui/highgui_c.h>
 #include <opencv2/opencv.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/cstdint.hpp>
 #include <cinder/app/App.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <algorithm>
 
 using namespace viz;
 
-VideoIO::VideoIO(const std::string &inpath){
+namespace {
+
+  const char KEYFRAME_INDEX_MAGIC[4] = { 'V', 'K', 'F', 'I' };
+  const boost::uint32_t KEYFRAME_INDEX_VERSION = 1;
+  const boost::uint32_t AVIIF_KEYFRAME = 0x10;
+
+  boost::uint32_t ReadLittleEndian32(const unsigned char *bytes){
+    return (boost::uint32_t)bytes[0] | ((boost::uint32_t)bytes[1] << 8) | ((boost::uint32_t)bytes[2] << 16) | ((boost::uint32_t)bytes[3] << 24);
+  }
+
+  std::string KeyframeIndexPath(const std::string &inpath){
+    return inpath + ".kfidx";
+  }
+
+  std::string ProxyPath(const std::string &inpath, const int scale){
+    std::stringstream ss;
+    ss << inpath << ".proxy" << scale << ".avi";
+    return ss.str();
+  }
+
+}
+
+ProxyBuilder::ProxyBuilder(const std::string &inpath, const int scale) : input_path_(inpath), proxy_path_(ProxyPath(inpath, scale)), scale_(scale), ready_(false), cancel_(false) {
+
+  //a proxy is only up to date if it was finished after the source was last modified
+  if (boost::filesystem::exists(proxy_path_) && boost::filesystem::last_write_time(proxy_path_) >= boost::filesystem::last_write_time(input_path_)){
+    ready_ = true;
+    return;
+  }
+
+  thread_ = std::thread(std::bind(&ProxyBuilder::Build, this));
+
+}
+
+ProxyBuilder::~ProxyBuilder(){
+
+  cancel_ = true;
+  if (thread_.joinable()) thread_.join();
+
+}
+
+void ProxyBuilder::Build(){
+
+  //use .avi as the final extension so the writer picks the right container
+  const std::string partial_path = proxy_path_ + ".part.avi";
+
+  try{
+
+    cv::VideoCapture source(input_path_);
+    if (!source.isOpened()) return;
+
+    double fps = source.get(CV_CAP_PROP_FPS);
+    if (!(fps > 0)) fps = 25;
+
+    const cv::Size proxy_size((int)source.get(CV_CAP_PROP_FRAME_WIDTH) / scale_, (int)source.get(CV_CAP_PROP_FRAME_HEIGHT) / scale_);
+
+    cv::VideoWriter writer(partial_path, CV_FOURCC('M', 'J', 'P', 'G'), fps, proxy_size);
+    if (!writer.isOpened()) return;
+
+    //every source frame is written so frame indexes match between the source and the proxy
+    cv::Mat frame, small_frame;
+    while (!cancel_ && source.read(frame)){
+      cv::resize(frame, small_frame, proxy_size, 0, 0, cv::INTER_AREA);
+      writer << small_frame;
+    }
+
+    writer.release();
+
+    if (cancel_){
+      boost::filesystem::remove(partial_path);
+      return;
+    }
+
+    boost::filesystem::rename(partial_path, proxy_path_);
+    ready_ = true;
+
+  }
+  catch (std::exception &e){
+
+    //the proxy is an optimization so just keep using the full resolution video
+    std::cerr << "Error, could not build proxy video " << proxy_path_ << ": " << e.what() << "\n";
+
+  }
+
+}
+
+VideoIO::VideoIO(const std::string &inpath) : input_path_(inpath), using_proxy_(false) {
 
    if (boost::filesystem::path(inpath).extension().string() == ".png" ||
     boost::filesystem::path(inpath).extension().string() == ".jpg" ||
@@ -43,8 +135,11 @@ VideoIO::VideoIO(const std::string &inpath){
     if (!cap_.isOpened()) throw std::runtime_error("Error, could not open input video file");
     image_width_ = cap_.get(CV_CAP_PROP_FRAME_WIDTH);
     image_height_ = cap_.get(CV_CAP_PROP_FRAME_HEIGHT);
+    LoadKeyframeIndex(inpath);
   }
 
+  next_frame_ = 0;
+  decoder_frame_ = 0;
   can_read_ = true;
   is_open_ = true;
 
@@ -104,7 +199,7 @@ cv::Mat VideoIO::Read(){
   cv::Mat f;
 
   if (cap_.isOpened()){
-    cap_ >> f;
+    ReadFrame(f);
   }
   else if (!image_input_.empty()){
     f = image_input_.clone();
@@ -114,6 +209,9 @@ cv::Mat VideoIO::Read(){
     f = cv::Mat::zeros(cv::Size(image_width_, image_height_), CV_8UC3);
     can_read_ = false;
   }
+  else{
+    next_frame_++;
+  }
 
   return f;
 
@@ -127,14 +225,17 @@ void VideoIO::Read(cv::Mat &left, cv::Mat &right){
   }
 
   cv::Mat f;
-  cap_ >> f;
+  ReadFrame(f);
 
   if (f.data == 0x0){
     left = cv::Mat::zeros(cv::Size(image_width_/2, image_height_), CV_8UC3);
     right = cv::Mat::zeros(cv::Size(image_width_/2, image_height_), CV_8UC3);
     can_read_ = false;
+    return;
   }
 
+  next_frame_++;
+
   cv::Mat l = f(cv::Rect(0, 0, f.cols / 2, f.rows));
   l.copyTo(left);
 
@@ -167,4 +268,253 @@ void VideoIO::Write(const cv::Mat &left_frame, const cv::Mat &right_frame){
   right_frame.copyTo(rf);
   writer_ << frame;
 
-}
\ No newline at end of file
+}
+
+const cv::Mat &viz::PrepareFrameForUpload(const cv::Mat &frame, const cv::Size &target_size, cv::Mat &resize_buffer){
+
+  if (frame.size() == target_size) return frame;
+
+  cv::resize(frame, resize_buffer, target_size);
+  return resize_buffer;
+
+}
+
+void VideoIO::GenerateProxy(const int scale){
+
+  if (scale != 2 && scale != 4) throw std::runtime_error("Error, proxy scale must be 2 or 4");
+
+  if (!cap_.isOpened()) return;
+
+  proxy_builder_.reset(new ProxyBuilder(input_path_, scale));
+
+}
+
+bool VideoIO::UseProxy(const bool use_proxy){
+
+  if (use_proxy == using_proxy_) return true;
+
+  if (!cap_.isOpened()) return false;
+
+  if (use_proxy && (!proxy_builder_ || !proxy_builder_->IsReady())) return false;
+
+  const std::string path = use_proxy ? proxy_builder_->ProxyPath() : input_path_;
+
+  cv::VideoCapture cap(path);
+  if (!cap.isOpened()) return false;
+
+  //reopen at the start of the new file and seek back to where we were
+  const std::size_t frame = next_frame_;
+  cap_ = cap;
+  using_proxy_ = use_proxy;
+  next_frame_ = 0;
+  decoder_frame_ = 0;
+  LoadKeyframeIndex(path);
+
+  return Seek(frame);
+
+}
+
+bool VideoIO::Seek(const std::size_t frame){
+
+  if (!is_open_) return false;
+
+  //image inputs return the same frame forever
+  if (!cap_.isOpened()){
+    next_frame_ = frame;
+    can_read_ = true;
+    return true;
+  }
+
+  //cached frames don't need the decoder, it's moved if there is a cache miss
+  if (frame_cache_ && !using_proxy_ && frame_cache_->Contains(frame)){
+    next_frame_ = frame;
+    can_read_ = true;
+    return true;
+  }
+
+  if (!SeekDecoder(frame)){
+    can_read_ = false;
+    return false;
+  }
+
+  next_frame_ = frame;
+  can_read_ = true;
+  return true;
+
+}
+
+bool VideoIO::SeekDecoder(const std::size_t frame){
+
+  const std::size_t keyframe = NearestKeyframe(frame);
+
+  //only jump if going backwards or if there is a keyframe between here and the target, otherwise decoding forward is cheaper
+  if (frame < decoder_frame_ || keyframe > decoder_frame_){
+    if (!cap_.set(CV_CAP_PROP_POS_FRAMES, (double)keyframe)) return false;
+    decoder_frame_ = keyframe;
+  }
+
+  while (decoder_frame_ < frame){
+    if (!cap_.grab()) return false;
+    decoder_frame_++;
+  }
+
+  return true;
+
+}
+
+bool VideoIO::ReadFrame(cv::Mat &frame){
+
+  const bool use_cache = frame_cache_ && !using_proxy_;
+
+  if (use_cache && frame_cache_->Get(next_frame_, frame)) return true;
+
+  if (decoder_frame_ != next_frame_ && !SeekDecoder(next_frame_)){
+    frame = cv::Mat();
+    return false;
+  }
+
+  cap_ >> frame;
+  if (frame.data == 0x0) return false;
+
+  decoder_frame_++;
+
+  if (use_cache) frame_cache_->Put(next_frame_, frame);
+
+  return true;
+
+}
+
+void VideoIO::EnableFrameCache(const std::size_t budget_bytes){
+
+  if (!cap_.isOpened()) return;
+
+  //the decoder always gives 8 bit BGR frames
+  frame_cache_.reset(new FrameCache(input_path_, cv::Size(image_width_, image_height_), CV_8UC3, budget_bytes));
+
+}
+
+std::size_t VideoIO::NearestKeyframe(const std::size_t frame) const {
+
+  if (keyframes_.empty()) return 0;
+
+  std::vector<std::size_t>::const_iterator it = std::upper_bound(keyframes_.begin(), keyframes_.end(), frame);
+  if (it == keyframes_.begin()) return 0;
+  return *(--it);
+
+}
+
+void VideoIO::LoadKeyframeIndex(const std::string &inpath){
+
+  keyframes_.clear();
+
+  const boost::uint64_t file_size = boost::filesystem::file_size(inpath);
+  const boost::int64_t write_time = boost::filesystem::last_write_time(inpath);
+  const std::string index_path = KeyframeIndexPath(inpath);
+
+  //try the cache first, it's only valid if the video hasn't changed since it was written
+  std::ifstream ifs(index_path.c_str(), std::ios::binary);
+  if (ifs.is_open()){
+
+    char magic[4];
+    boost::uint32_t version = 0;
+    boost::uint64_t cached_size = 0, num_keyframes = 0;
+    boost::int64_t cached_time = 0;
+
+    ifs.read(magic, sizeof(magic));
+    ifs.read((char *)&version, sizeof(version));
+    ifs.read((char *)&cached_size, sizeof(cached_size));
+    ifs.read((char *)&cached_time, sizeof(cached_time));
+    ifs.read((char *)&num_keyframes, sizeof(num_keyframes));
+
+    if (ifs.good() && std::equal(magic, magic + 4, KEYFRAME_INDEX_MAGIC) && version == KEYFRAME_INDEX_VERSION && cached_size == file_size && cached_time == write_time){
+
+      std::vector<boost::uint64_t> keyframes((std::size_t)num_keyframes);
+      if (num_keyframes > 0) ifs.read((char *)&keyframes[0], num_keyframes * sizeof(boost::uint64_t));
+
+      if (ifs.good()){
+        keyframes_.assign(keyframes.begin(), keyframes.end());
+        return;
+      }
+
+    }
+
+    keyframes_.clear();
+
+  }
+
+  if (!BuildKeyframeIndexFromAvi(inpath)){
+    //no index we can use, so every seek has to decode forward from the start of the video
+    keyframes_.assign(1, 0);
+  }
+
+  std::ofstream ofs(index_path.c_str(), std::ios::binary);
+  if (!ofs.is_open()) return; //not an error, we just rebuild the index next time
+
+  std::vector<boost::uint64_t> keyframes(keyframes_.begin(), keyframes_.end());
+  boost::uint64_t num_keyframes = keyframes.size();
+
+  ofs.write(KEYFRAME_INDEX_MAGIC, sizeof(KEYFRAME_INDEX_MAGIC));
+  ofs.write((const char *)&KEYFRAME_INDEX_VERSION, sizeof(KEYFRAME_INDEX_VERSION));
+  ofs.write((const char *)&file_size, sizeof(file_size));
+  ofs.write((const char *)&write_time, sizeof(write_time));
+  ofs.write((const char *)&num_keyframes, sizeof(num_keyframes));
+  ofs.write((const char *)&keyframes[0], num_keyframes * sizeof(boost::uint64_t));
+
+}
+
+bool VideoIO::BuildKeyframeIndexFromAvi(const std::string &inpath){
+
+  if (boost::filesystem::path(inpath).extension().string() != ".avi") return false;
+
+  std::ifstream ifs(inpath.c_str(), std::ios::binary);
+  if (!ifs.is_open()) return false;
+
+  const boost::uint64_t file_size = boost::filesystem::file_size(inpath);
+
+  unsigned char header[12];
+  ifs.read((char *)header, sizeof(header));
+  if (!ifs.good() || !std::equal(header, header + 4, "RIFF") || !std::equal(header + 8, header + 12, "AVI ")) return false;
+
+  //walk the top level chunks looking for the legacy index
+  boost::uint64_t position = sizeof(header);
+  while (position + 8 <= file_size){
+
+    unsigned char chunk[8];
+    ifs.seekg((std::streamoff)position);
+    ifs.read((char *)chunk, sizeof(chunk));
+    if (!ifs.good()) return false;
+
+    const boost::uint32_t chunk_size = ReadLittleEndian32(chunk + 4);
+
+    if (std::equal(chunk, chunk + 4, "idx1")){
+
+      std::vector<unsigned char> entries(chunk_size);
+      if (chunk_size > 0) ifs.read((char *)&entries[0], chunk_size);
+      if (!ifs.good()) return false;
+
+      //each entry is ckid, flags, offset, size. video chunks are ##dc (compressed) or ##db (uncompressed)
+      std::size_t frame = 0;
+      for (std::size_t e = 0; e + 16 <= entries.size(); e += 16){
+
+        const unsigned char *entry = &entries[e];
+        if (!((entry[2] == 'd' && entry[3] == 'c') || (entry[2] == 'd' && entry[3] == 'b'))) continue;
+
+        if (ReadLittleEndian32(entry + 4) & AVIIF_KEYFRAME) keyframes_.push_back(frame);
+        frame++;
+
+      }
+
+      if (frame == 0) return false;
+
+      if (keyframes_.empty() || keyframes_.front() != 0) keyframes_.insert(keyframes_.begin(), 0);
+      return true;
+
+    }
+
+    position += 8 + chunk_size + (chunk_size & 1);
+
+  }
+
+  return false;
+
+}